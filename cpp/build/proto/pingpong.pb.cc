@@ -23,10 +23,13 @@ namespace _pbi = _pb::internal;
 namespace pingpong {
 PROTOBUF_CONSTEXPR Ping::Ping(
     ::_pbi::ConstantInitialized): _impl_{
-    /*decltype(_impl_.payload_)*/{&::_pbi::fixed_address_empty_string, ::_pbi::ConstantInitialized{}}
+    /*decltype(_impl_._has_bits_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}
+  , /*decltype(_impl_.payload_)*/{&::_pbi::fixed_address_empty_string, ::_pbi::ConstantInitialized{}}
   , /*decltype(_impl_.sequence_)*/uint64_t{0u}
   , /*decltype(_impl_.timestamp_)*/uint64_t{0u}
-  , /*decltype(_impl_._cached_size_)*/{}} {}
+  , /*decltype(_impl_.more_)*/false
+  , /*decltype(_impl_.checksum_)*/0u} {}
 struct PingDefaultTypeInternal {
   PROTOBUF_CONSTEXPR PingDefaultTypeInternal()
       : _instance(::_pbi::ConstantInitialized{}) {}
@@ -38,11 +41,15 @@ struct PingDefaultTypeInternal {
 PROTOBUF_ATTRIBUTE_NO_DESTROY PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1 PingDefaultTypeInternal _Ping_default_instance_;
 PROTOBUF_CONSTEXPR Pong::Pong(
     ::_pbi::ConstantInitialized): _impl_{
-    /*decltype(_impl_.payload_)*/{&::_pbi::fixed_address_empty_string, ::_pbi::ConstantInitialized{}}
+    /*decltype(_impl_._has_bits_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}
+  , /*decltype(_impl_.payload_)*/{&::_pbi::fixed_address_empty_string, ::_pbi::ConstantInitialized{}}
   , /*decltype(_impl_.sequence_)*/uint64_t{0u}
   , /*decltype(_impl_.timestamp_)*/uint64_t{0u}
   , /*decltype(_impl_.server_timestamp_)*/uint64_t{0u}
-  , /*decltype(_impl_._cached_size_)*/{}} {}
+  , /*decltype(_impl_.work_result_)*/uint64_t{0u}
+  , /*decltype(_impl_.more_)*/false
+  , /*decltype(_impl_.checksum_)*/0u} {}
 struct PongDefaultTypeInternal {
   PROTOBUF_CONSTEXPR PongDefaultTypeInternal()
       : _instance(::_pbi::ConstantInitialized{}) {}
@@ -58,7 +65,7 @@ static constexpr ::_pb::EnumDescriptor const** file_level_enum_descriptors_pingp
 static constexpr ::_pb::ServiceDescriptor const** file_level_service_descriptors_pingpong_2eproto = nullptr;
 
 const uint32_t TableStruct_pingpong_2eproto::offsets[] PROTOBUF_SECTION_VARIABLE(protodesc_cold) = {
-  ~0u,  // no _has_bits_
+  PROTOBUF_FIELD_OFFSET(::pingpong::Ping, _impl_._has_bits_),
   PROTOBUF_FIELD_OFFSET(::pingpong::Ping, _internal_metadata_),
   ~0u,  // no _extensions_
   ~0u,  // no _oneof_case_
@@ -67,7 +74,14 @@ const uint32_t TableStruct_pingpong_2eproto::offsets[] PROTOBUF_SECTION_VARIABLE
   PROTOBUF_FIELD_OFFSET(::pingpong::Ping, _impl_.sequence_),
   PROTOBUF_FIELD_OFFSET(::pingpong::Ping, _impl_.timestamp_),
   PROTOBUF_FIELD_OFFSET(::pingpong::Ping, _impl_.payload_),
-  ~0u,  // no _has_bits_
+  PROTOBUF_FIELD_OFFSET(::pingpong::Ping, _impl_.more_),
+  PROTOBUF_FIELD_OFFSET(::pingpong::Ping, _impl_.checksum_),
+  ~0u,
+  ~0u,
+  ~0u,
+  ~0u,
+  0,
+  PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _impl_._has_bits_),
   PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _internal_metadata_),
   ~0u,  // no _extensions_
   ~0u,  // no _oneof_case_
@@ -77,10 +91,20 @@ const uint32_t TableStruct_pingpong_2eproto::offsets[] PROTOBUF_SECTION_VARIABLE
   PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _impl_.timestamp_),
   PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _impl_.server_timestamp_),
   PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _impl_.payload_),
+  PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _impl_.more_),
+  PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _impl_.work_result_),
+  PROTOBUF_FIELD_OFFSET(::pingpong::Pong, _impl_.checksum_),
+  ~0u,
+  ~0u,
+  ~0u,
+  ~0u,
+  ~0u,
+  ~0u,
+  0,
 };
 static const ::_pbi::MigrationSchema schemas[] PROTOBUF_SECTION_VARIABLE(protodesc_cold) = {
-  { 0, -1, -1, sizeof(::pingpong::Ping)},
-  { 9, -1, -1, sizeof(::pingpong::Pong)},
+  { 0, 11, -1, sizeof(::pingpong::Ping)},
+  { 16, 29, -1, sizeof(::pingpong::Pong)},
 };
 
 static const ::_pb::Message* const file_default_instances[] = {
@@ -89,17 +113,20 @@ static const ::_pb::Message* const file_default_instances[] = {
 };
 
 const char descriptor_table_protodef_pingpong_2eproto[] PROTOBUF_SECTION_VARIABLE(protodesc_cold) =
-  "\n\016pingpong.proto\022\010pingpong\"<\n\004Ping\022\020\n\010se"
+  "\n\016pingpong.proto\022\010pingpong\"n\n\004Ping\022\020\n\010se"
   "quence\030\001 \001(\004\022\021\n\ttimestamp\030\002 \001(\004\022\017\n\007paylo"
-  "ad\030\003 \001(\014\"V\n\004Pong\022\020\n\010sequence\030\001 \001(\004\022\021\n\tti"
-  "mestamp\030\002 \001(\004\022\030\n\020server_timestamp\030\003 \001(\004\022"
-  "\017\n\007payload\030\004 \001(\0142B\n\010PingPong\0226\n\016StreamPi"
-  "ngPong\022\016.pingpong.Ping\032\016.pingpong.Pong\"\000"
-  "(\0010\001B\024Z\022pkg/proto/pingpongb\006proto3"
+  "ad\030\003 \001(\014\022\014\n\004more\030\004 \001(\010\022\025\n\010checksum\030\005 \001(\007"
+  "H\000\210\001\001B\013\n\t_checksum\"\235\001\n\004Pong\022\020\n\010sequence\030"
+  "\001 \001(\004\022\021\n\ttimestamp\030\002 \001(\004\022\030\n\020server_times"
+  "tamp\030\003 \001(\004\022\017\n\007payload\030\004 \001(\014\022\014\n\004more\030\005 \001("
+  "\010\022\023\n\013work_result\030\006 \001(\004\022\025\n\010checksum\030\007 \001(\007"
+  "H\000\210\001\001B\013\n\t_checksum2B\n\010PingPong\0226\n\016Stream"
+  "PingPong\022\016.pingpong.Ping\032\016.pingpong.Pong"
+  "\"\000(\0010\001B\024Z\022pkg/proto/pingpongb\006proto3"
   ;
 static ::_pbi::once_flag descriptor_table_pingpong_2eproto_once;
 const ::_pbi::DescriptorTable descriptor_table_pingpong_2eproto = {
-    false, false, 274, descriptor_table_protodef_pingpong_2eproto,
+    false, false, 396, descriptor_table_protodef_pingpong_2eproto,
     "pingpong.proto",
     &descriptor_table_pingpong_2eproto_once, nullptr, 0, 2,
     schemas, file_default_instances, TableStruct_pingpong_2eproto::offsets,
@@ -118,6 +145,10 @@ namespace pingpong {
 
 class Ping::_Internal {
  public:
+  using HasBits = decltype(std::declval<Ping>()._impl_._has_bits_);
+  static void set_has_checksum(HasBits* has_bits) {
+    (*has_bits)[0] |= 1u;
+  }
 };
 
 Ping::Ping(::PROTOBUF_NAMESPACE_ID::Arena* arena,
@@ -130,10 +161,13 @@ Ping::Ping(const Ping& from)
   : ::PROTOBUF_NAMESPACE_ID::Message() {
   Ping* const _this = this; (void)_this;
   new (&_impl_) Impl_{
-      decltype(_impl_.payload_){}
+      decltype(_impl_._has_bits_){from._impl_._has_bits_}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.payload_){}
     , decltype(_impl_.sequence_){}
     , decltype(_impl_.timestamp_){}
-    , /*decltype(_impl_._cached_size_)*/{}};
+    , decltype(_impl_.more_){}
+    , decltype(_impl_.checksum_){}};
 
   _internal_metadata_.MergeFrom<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(from._internal_metadata_);
   _impl_.payload_.InitDefault();
@@ -145,8 +179,8 @@ Ping::Ping(const Ping& from)
       _this->GetArenaForAllocation());
   }
   ::memcpy(&_impl_.sequence_, &from._impl_.sequence_,
-    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.timestamp_) -
-    reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.timestamp_));
+    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.checksum_) -
+    reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.checksum_));
   // @@protoc_insertion_point(copy_constructor:pingpong.Ping)
 }
 
@@ -155,10 +189,13 @@ inline void Ping::SharedCtor(
   (void)arena;
   (void)is_message_owned;
   new (&_impl_) Impl_{
-      decltype(_impl_.payload_){}
+      decltype(_impl_._has_bits_){}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.payload_){}
     , decltype(_impl_.sequence_){uint64_t{0u}}
     , decltype(_impl_.timestamp_){uint64_t{0u}}
-    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.more_){false}
+    , decltype(_impl_.checksum_){0u}
   };
   _impl_.payload_.InitDefault();
   #ifdef PROTOBUF_FORCE_COPY_DEFAULT_STRING
@@ -192,13 +229,16 @@ void Ping::Clear() {
 
   _impl_.payload_.ClearToEmpty();
   ::memset(&_impl_.sequence_, 0, static_cast<size_t>(
-      reinterpret_cast<char*>(&_impl_.timestamp_) -
-      reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.timestamp_));
+      reinterpret_cast<char*>(&_impl_.more_) -
+      reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.more_));
+  _impl_.checksum_ = 0u;
+  _impl_._has_bits_.Clear();
   _internal_metadata_.Clear<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>();
 }
 
 const char* Ping::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
 #define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  _Internal::HasBits has_bits{};
   while (!ctx->Done(&ptr)) {
     uint32_t tag;
     ptr = ::_pbi::ReadTag(ptr, &tag);
@@ -228,6 +268,23 @@ const char* Ping::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
         } else
           goto handle_unusual;
         continue;
+      // bool more = 4;
+      case 4:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 32)) {
+          _impl_.more_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional fixed32 checksum = 5;
+      case 5:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 45)) {
+          _Internal::set_has_checksum(&has_bits);
+          _impl_.checksum_ = ::PROTOBUF_NAMESPACE_ID::internal::UnalignedLoad<uint32_t>(ptr);
+          ptr += sizeof(uint32_t);
+        } else
+          goto handle_unusual;
+        continue;
       default:
         goto handle_unusual;
     }  // switch
@@ -244,6 +301,7 @@ const char* Ping::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
     CHK_(ptr != nullptr);
   }  // while
 message_done:
+  _impl_._has_bits_.Or(has_bits);
   return ptr;
 failure:
   ptr = nullptr;
@@ -275,6 +333,18 @@ uint8_t* Ping::_InternalSerialize(
         3, this->_internal_payload(), target);
   }
 
+  // bool more = 4;
+  if (this->_internal_more() != 0) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteBoolToArray(4, this->_internal_more(), target);
+  }
+
+  // optional fixed32 checksum = 5;
+  if (_internal_has_checksum()) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteFixed32ToArray(5, this->_internal_checksum(), target);
+  }
+
   if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
     target = ::_pbi::WireFormat::InternalSerializeUnknownFieldsToArray(
         _internal_metadata_.unknown_fields<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(::PROTOBUF_NAMESPACE_ID::UnknownFieldSet::default_instance), target, stream);
@@ -308,6 +378,17 @@ size_t Ping::ByteSizeLong() const {
     total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_timestamp());
   }
 
+  // bool more = 4;
+  if (this->_internal_more() != 0) {
+    total_size += 1 + 1;
+  }
+
+  // optional fixed32 checksum = 5;
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000001u) {
+    total_size += 1 + 4;
+  }
+
   return MaybeComputeUnknownFieldsSize(total_size, &_impl_._cached_size_);
 }
 
@@ -335,6 +416,12 @@ void Ping::MergeImpl(::PROTOBUF_NAMESPACE_ID::Message& to_msg, const ::PROTOBUF_
   if (from._internal_timestamp() != 0) {
     _this->_internal_set_timestamp(from._internal_timestamp());
   }
+  if (from._internal_more() != 0) {
+    _this->_internal_set_more(from._internal_more());
+  }
+  if (from._internal_has_checksum()) {
+    _this->_internal_set_checksum(from._internal_checksum());
+  }
   _this->_internal_metadata_.MergeFrom<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(from._internal_metadata_);
 }
 
@@ -354,13 +441,14 @@ void Ping::InternalSwap(Ping* other) {
   auto* lhs_arena = GetArenaForAllocation();
   auto* rhs_arena = other->GetArenaForAllocation();
   _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+  swap(_impl_._has_bits_[0], other->_impl_._has_bits_[0]);
   ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr::InternalSwap(
       &_impl_.payload_, lhs_arena,
       &other->_impl_.payload_, rhs_arena
   );
   ::PROTOBUF_NAMESPACE_ID::internal::memswap<
-      PROTOBUF_FIELD_OFFSET(Ping, _impl_.timestamp_)
-      + sizeof(Ping::_impl_.timestamp_)
+      PROTOBUF_FIELD_OFFSET(Ping, _impl_.checksum_)
+      + sizeof(Ping::_impl_.checksum_)
       - PROTOBUF_FIELD_OFFSET(Ping, _impl_.sequence_)>(
           reinterpret_cast<char*>(&_impl_.sequence_),
           reinterpret_cast<char*>(&other->_impl_.sequence_));
@@ -376,6 +464,10 @@ void Ping::InternalSwap(Ping* other) {
 
 class Pong::_Internal {
  public:
+  using HasBits = decltype(std::declval<Pong>()._impl_._has_bits_);
+  static void set_has_checksum(HasBits* has_bits) {
+    (*has_bits)[0] |= 1u;
+  }
 };
 
 Pong::Pong(::PROTOBUF_NAMESPACE_ID::Arena* arena,
@@ -388,11 +480,15 @@ Pong::Pong(const Pong& from)
   : ::PROTOBUF_NAMESPACE_ID::Message() {
   Pong* const _this = this; (void)_this;
   new (&_impl_) Impl_{
-      decltype(_impl_.payload_){}
+      decltype(_impl_._has_bits_){from._impl_._has_bits_}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.payload_){}
     , decltype(_impl_.sequence_){}
     , decltype(_impl_.timestamp_){}
     , decltype(_impl_.server_timestamp_){}
-    , /*decltype(_impl_._cached_size_)*/{}};
+    , decltype(_impl_.work_result_){}
+    , decltype(_impl_.more_){}
+    , decltype(_impl_.checksum_){}};
 
   _internal_metadata_.MergeFrom<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(from._internal_metadata_);
   _impl_.payload_.InitDefault();
@@ -404,8 +500,8 @@ Pong::Pong(const Pong& from)
       _this->GetArenaForAllocation());
   }
   ::memcpy(&_impl_.sequence_, &from._impl_.sequence_,
-    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.server_timestamp_) -
-    reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.server_timestamp_));
+    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.checksum_) -
+    reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.checksum_));
   // @@protoc_insertion_point(copy_constructor:pingpong.Pong)
 }
 
@@ -414,11 +510,15 @@ inline void Pong::SharedCtor(
   (void)arena;
   (void)is_message_owned;
   new (&_impl_) Impl_{
-      decltype(_impl_.payload_){}
+      decltype(_impl_._has_bits_){}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.payload_){}
     , decltype(_impl_.sequence_){uint64_t{0u}}
     , decltype(_impl_.timestamp_){uint64_t{0u}}
     , decltype(_impl_.server_timestamp_){uint64_t{0u}}
-    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.work_result_){uint64_t{0u}}
+    , decltype(_impl_.more_){false}
+    , decltype(_impl_.checksum_){0u}
   };
   _impl_.payload_.InitDefault();
   #ifdef PROTOBUF_FORCE_COPY_DEFAULT_STRING
@@ -452,13 +552,16 @@ void Pong::Clear() {
 
   _impl_.payload_.ClearToEmpty();
   ::memset(&_impl_.sequence_, 0, static_cast<size_t>(
-      reinterpret_cast<char*>(&_impl_.server_timestamp_) -
-      reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.server_timestamp_));
+      reinterpret_cast<char*>(&_impl_.more_) -
+      reinterpret_cast<char*>(&_impl_.sequence_)) + sizeof(_impl_.more_));
+  _impl_.checksum_ = 0u;
+  _impl_._has_bits_.Clear();
   _internal_metadata_.Clear<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>();
 }
 
 const char* Pong::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
 #define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  _Internal::HasBits has_bits{};
   while (!ctx->Done(&ptr)) {
     uint32_t tag;
     ptr = ::_pbi::ReadTag(ptr, &tag);
@@ -496,6 +599,31 @@ const char* Pong::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
         } else
           goto handle_unusual;
         continue;
+      // bool more = 5;
+      case 5:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 40)) {
+          _impl_.more_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // uint64 work_result = 6;
+      case 6:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 48)) {
+          _impl_.work_result_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional fixed32 checksum = 7;
+      case 7:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 61)) {
+          _Internal::set_has_checksum(&has_bits);
+          _impl_.checksum_ = ::PROTOBUF_NAMESPACE_ID::internal::UnalignedLoad<uint32_t>(ptr);
+          ptr += sizeof(uint32_t);
+        } else
+          goto handle_unusual;
+        continue;
       default:
         goto handle_unusual;
     }  // switch
@@ -512,6 +640,7 @@ const char* Pong::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
     CHK_(ptr != nullptr);
   }  // while
 message_done:
+  _impl_._has_bits_.Or(has_bits);
   return ptr;
 failure:
   ptr = nullptr;
@@ -549,6 +678,24 @@ uint8_t* Pong::_InternalSerialize(
         4, this->_internal_payload(), target);
   }
 
+  // bool more = 5;
+  if (this->_internal_more() != 0) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteBoolToArray(5, this->_internal_more(), target);
+  }
+
+  // uint64 work_result = 6;
+  if (this->_internal_work_result() != 0) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteUInt64ToArray(6, this->_internal_work_result(), target);
+  }
+
+  // optional fixed32 checksum = 7;
+  if (_internal_has_checksum()) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteFixed32ToArray(7, this->_internal_checksum(), target);
+  }
+
   if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
     target = ::_pbi::WireFormat::InternalSerializeUnknownFieldsToArray(
         _internal_metadata_.unknown_fields<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(::PROTOBUF_NAMESPACE_ID::UnknownFieldSet::default_instance), target, stream);
@@ -587,6 +734,22 @@ size_t Pong::ByteSizeLong() const {
     total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_server_timestamp());
   }
 
+  // uint64 work_result = 6;
+  if (this->_internal_work_result() != 0) {
+    total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_work_result());
+  }
+
+  // bool more = 5;
+  if (this->_internal_more() != 0) {
+    total_size += 1 + 1;
+  }
+
+  // optional fixed32 checksum = 7;
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000001u) {
+    total_size += 1 + 4;
+  }
+
   return MaybeComputeUnknownFieldsSize(total_size, &_impl_._cached_size_);
 }
 
@@ -617,6 +780,15 @@ void Pong::MergeImpl(::PROTOBUF_NAMESPACE_ID::Message& to_msg, const ::PROTOBUF_
   if (from._internal_server_timestamp() != 0) {
     _this->_internal_set_server_timestamp(from._internal_server_timestamp());
   }
+  if (from._internal_work_result() != 0) {
+    _this->_internal_set_work_result(from._internal_work_result());
+  }
+  if (from._internal_more() != 0) {
+    _this->_internal_set_more(from._internal_more());
+  }
+  if (from._internal_has_checksum()) {
+    _this->_internal_set_checksum(from._internal_checksum());
+  }
   _this->_internal_metadata_.MergeFrom<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(from._internal_metadata_);
 }
 
@@ -636,13 +808,14 @@ void Pong::InternalSwap(Pong* other) {
   auto* lhs_arena = GetArenaForAllocation();
   auto* rhs_arena = other->GetArenaForAllocation();
   _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+  swap(_impl_._has_bits_[0], other->_impl_._has_bits_[0]);
   ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr::InternalSwap(
       &_impl_.payload_, lhs_arena,
       &other->_impl_.payload_, rhs_arena
   );
   ::PROTOBUF_NAMESPACE_ID::internal::memswap<
-      PROTOBUF_FIELD_OFFSET(Pong, _impl_.server_timestamp_)
-      + sizeof(Pong::_impl_.server_timestamp_)
+      PROTOBUF_FIELD_OFFSET(Pong, _impl_.checksum_)
+      + sizeof(Pong::_impl_.checksum_)
       - PROTOBUF_FIELD_OFFSET(Pong, _impl_.sequence_)>(
           reinterpret_cast<char*>(&_impl_.sequence_),
           reinterpret_cast<char*>(&other->_impl_.sequence_));
@@ -184,6 +184,8 @@ class Ping final :
     kPayloadFieldNumber = 3,
     kSequenceFieldNumber = 1,
     kTimestampFieldNumber = 2,
+    kMoreFieldNumber = 4,
+    kChecksumFieldNumber = 5,
   };
   // bytes payload = 3;
   void clear_payload();
@@ -217,6 +219,28 @@ class Ping final :
   void _internal_set_timestamp(uint64_t value);
   public:
 
+  // bool more = 4;
+  void clear_more();
+  bool more() const;
+  void set_more(bool value);
+  private:
+  bool _internal_more() const;
+  void _internal_set_more(bool value);
+  public:
+
+  // optional fixed32 checksum = 5;
+  bool has_checksum() const;
+  private:
+  bool _internal_has_checksum() const;
+  public:
+  void clear_checksum();
+  uint32_t checksum() const;
+  void set_checksum(uint32_t value);
+  private:
+  uint32_t _internal_checksum() const;
+  void _internal_set_checksum(uint32_t value);
+  public:
+
   // @@protoc_insertion_point(class_scope:pingpong.Ping)
  private:
   class _Internal;
@@ -225,10 +249,13 @@ class Ping final :
   typedef void InternalArenaConstructable_;
   typedef void DestructorSkippable_;
   struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::internal::HasBits<1> _has_bits_;
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
     ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr payload_;
     uint64_t sequence_;
     uint64_t timestamp_;
-    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+    bool more_;
+    uint32_t checksum_;
   };
   union { Impl_ _impl_; };
   friend struct ::TableStruct_pingpong_2eproto;
@@ -360,6 +387,9 @@ class Pong final :
     kSequenceFieldNumber = 1,
     kTimestampFieldNumber = 2,
     kServerTimestampFieldNumber = 3,
+    kWorkResultFieldNumber = 6,
+    kMoreFieldNumber = 5,
+    kChecksumFieldNumber = 7,
   };
   // bytes payload = 4;
   void clear_payload();
@@ -402,6 +432,37 @@ class Pong final :
   void _internal_set_server_timestamp(uint64_t value);
   public:
 
+  // uint64 work_result = 6;
+  void clear_work_result();
+  uint64_t work_result() const;
+  void set_work_result(uint64_t value);
+  private:
+  uint64_t _internal_work_result() const;
+  void _internal_set_work_result(uint64_t value);
+  public:
+
+  // bool more = 5;
+  void clear_more();
+  bool more() const;
+  void set_more(bool value);
+  private:
+  bool _internal_more() const;
+  void _internal_set_more(bool value);
+  public:
+
+  // optional fixed32 checksum = 7;
+  bool has_checksum() const;
+  private:
+  bool _internal_has_checksum() const;
+  public:
+  void clear_checksum();
+  uint32_t checksum() const;
+  void set_checksum(uint32_t value);
+  private:
+  uint32_t _internal_checksum() const;
+  void _internal_set_checksum(uint32_t value);
+  public:
+
   // @@protoc_insertion_point(class_scope:pingpong.Pong)
  private:
   class _Internal;
@@ -410,11 +471,15 @@ class Pong final :
   typedef void InternalArenaConstructable_;
   typedef void DestructorSkippable_;
   struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::internal::HasBits<1> _has_bits_;
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
     ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr payload_;
     uint64_t sequence_;
     uint64_t timestamp_;
     uint64_t server_timestamp_;
-    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+    uint64_t work_result_;
+    bool more_;
+    uint32_t checksum_;
   };
   union { Impl_ _impl_; };
   friend struct ::TableStruct_pingpong_2eproto;
@@ -520,6 +585,54 @@ inline void Ping::set_allocated_payload(std::string* payload) {
   // @@protoc_insertion_point(field_set_allocated:pingpong.Ping.payload)
 }
 
+// bool more = 4;
+inline void Ping::clear_more() {
+  _impl_.more_ = false;
+}
+inline bool Ping::_internal_more() const {
+  return _impl_.more_;
+}
+inline bool Ping::more() const {
+  // @@protoc_insertion_point(field_get:pingpong.Ping.more)
+  return _internal_more();
+}
+inline void Ping::_internal_set_more(bool value) {
+  
+  _impl_.more_ = value;
+}
+inline void Ping::set_more(bool value) {
+  _internal_set_more(value);
+  // @@protoc_insertion_point(field_set:pingpong.Ping.more)
+}
+
+// optional fixed32 checksum = 5;
+inline bool Ping::_internal_has_checksum() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000001u) != 0;
+  return value;
+}
+inline bool Ping::has_checksum() const {
+  return _internal_has_checksum();
+}
+inline void Ping::clear_checksum() {
+  _impl_.checksum_ = 0u;
+  _impl_._has_bits_[0] &= ~0x00000001u;
+}
+inline uint32_t Ping::_internal_checksum() const {
+  return _impl_.checksum_;
+}
+inline uint32_t Ping::checksum() const {
+  // @@protoc_insertion_point(field_get:pingpong.Ping.checksum)
+  return _internal_checksum();
+}
+inline void Ping::_internal_set_checksum(uint32_t value) {
+  _impl_._has_bits_[0] |= 0x00000001u;
+  _impl_.checksum_ = value;
+}
+inline void Ping::set_checksum(uint32_t value) {
+  _internal_set_checksum(value);
+  // @@protoc_insertion_point(field_set:pingpong.Ping.checksum)
+}
+
 // -------------------------------------------------------------------
 
 // Pong
@@ -634,6 +747,74 @@ inline void Pong::set_allocated_payload(std::string* payload) {
   // @@protoc_insertion_point(field_set_allocated:pingpong.Pong.payload)
 }
 
+// bool more = 5;
+inline void Pong::clear_more() {
+  _impl_.more_ = false;
+}
+inline bool Pong::_internal_more() const {
+  return _impl_.more_;
+}
+inline bool Pong::more() const {
+  // @@protoc_insertion_point(field_get:pingpong.Pong.more)
+  return _internal_more();
+}
+inline void Pong::_internal_set_more(bool value) {
+  
+  _impl_.more_ = value;
+}
+inline void Pong::set_more(bool value) {
+  _internal_set_more(value);
+  // @@protoc_insertion_point(field_set:pingpong.Pong.more)
+}
+
+// uint64 work_result = 6;
+inline void Pong::clear_work_result() {
+  _impl_.work_result_ = uint64_t{0u};
+}
+inline uint64_t Pong::_internal_work_result() const {
+  return _impl_.work_result_;
+}
+inline uint64_t Pong::work_result() const {
+  // @@protoc_insertion_point(field_get:pingpong.Pong.work_result)
+  return _internal_work_result();
+}
+inline void Pong::_internal_set_work_result(uint64_t value) {
+  
+  _impl_.work_result_ = value;
+}
+inline void Pong::set_work_result(uint64_t value) {
+  _internal_set_work_result(value);
+  // @@protoc_insertion_point(field_set:pingpong.Pong.work_result)
+}
+
+// optional fixed32 checksum = 7;
+inline bool Pong::_internal_has_checksum() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000001u) != 0;
+  return value;
+}
+inline bool Pong::has_checksum() const {
+  return _internal_has_checksum();
+}
+inline void Pong::clear_checksum() {
+  _impl_.checksum_ = 0u;
+  _impl_._has_bits_[0] &= ~0x00000001u;
+}
+inline uint32_t Pong::_internal_checksum() const {
+  return _impl_.checksum_;
+}
+inline uint32_t Pong::checksum() const {
+  // @@protoc_insertion_point(field_get:pingpong.Pong.checksum)
+  return _internal_checksum();
+}
+inline void Pong::_internal_set_checksum(uint32_t value) {
+  _impl_._has_bits_[0] |= 0x00000001u;
+  _impl_.checksum_ = value;
+}
+inline void Pong::set_checksum(uint32_t value) {
+  _internal_set_checksum(value);
+  // @@protoc_insertion_point(field_set:pingpong.Pong.checksum)
+}
+
 #ifdef __GNUC__
   #pragma GCC diagnostic pop
 #endif  // __GNUC__
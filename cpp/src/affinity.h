@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// Parses a Linux cpu list such as "0-3,8,10-11"
+inline bool ParseCpuList(const std::string &list, std::vector<int> *cpus) {
+  cpus->clear();
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+    size_t end = 0;
+    int first;
+    int last;
+    try {
+      first = std::stoi(range, &end);
+      last = first;
+      if (end < range.size() && range[end] == '-') {
+        size_t rest = 0;
+        last = std::stoi(range.substr(end + 1), &rest);
+        end += 1 + rest;
+      }
+    } catch (const std::exception &) {
+      return false;
+    }
+    if (first < 0 || last < first || last >= CPU_SETSIZE ||
+        range.find_first_not_of(" \n", end) != std::string::npos) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus->push_back(cpu);
+    }
+  }
+  return !cpus->empty();
+}
+
+inline bool NodeCpus(int node, std::vector<int> *cpus) {
+  std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) +
+                   "/cpulist");
+  std::string list;
+  return std::getline(in, list) && ParseCpuList(list, cpus);
+}
+
+// Restricts the calling thread to cpus; threads it creates afterwards
+// inherit the mask
+inline bool SetThreadCpus(const std::vector<int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Allocations of the calling thread, and of threads it creates afterwards,
+// come from node only
+inline bool BindMemoryToNode(int node) {
+  unsigned long mask[16] = {};
+  constexpr int kBits = 8 * sizeof(unsigned long);
+  if (node < 0 || node >= kBits * 16) {
+    return false;
+  }
+  mask[node / kBits] = 1UL << (node % kBits);
+  return syscall(SYS_set_mempolicy, MPOL_BIND, mask, kBits * 16 + 1) == 0;
+}
+
+// Hands out the cores of the configured set one at a time, wrapping around
+// when there are more threads than cores. An empty set pins nothing.
+class CpuAssigner {
+  const std::vector<int> cpus_;
+  std::atomic<size_t> next_{0};
+
+public:
+  explicit CpuAssigner(std::vector<int> cpus) : cpus_(std::move(cpus)) {}
+
+  // Next core to pin a thread to, -1 when pinning is off
+  int Next() noexcept {
+    if (cpus_.empty()) {
+      return -1;
+    }
+    return cpus_[next_.fetch_add(1, std::memory_order_relaxed) %
+                 cpus_.size()];
+  }
+
+  // Pins the calling thread to cpu, if not -1. A failure, e.g. a core
+  // outside the process's cpuset, leaves the thread unpinned with a warning
+  // rather than stopping the server.
+  static bool Pin(int cpu) {
+    if (cpu < 0 || SetThreadCpus({cpu})) {
+      return true;
+    }
+    std::cerr << "Warning: pinning a thread to cpu " + std::to_string(cpu) +
+                     " failed\n";
+    return false;
+  }
+};
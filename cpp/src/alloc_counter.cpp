@@ -0,0 +1,69 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local uint64_t thread_allocations = 0;
+
+void *Allocate(std::size_t size) {
+  ++thread_allocations;
+  if (size == 0) {
+    size = 1;
+  }
+  for (;;) {
+    if (void *p = std::malloc(size)) {
+      return p;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void *AllocateAligned(std::size_t size, std::align_val_t align) {
+  ++thread_allocations;
+  const auto alignment = static_cast<std::size_t>(align);
+  // aligned_alloc wants the size to be a multiple of the alignment
+  size = (size + alignment - 1) & ~(alignment - 1);
+  if (size == 0) {
+    size = alignment;
+  }
+  for (;;) {
+    if (void *p = std::aligned_alloc(alignment, size)) {
+      return p;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+} // namespace
+
+uint64_t ThreadAllocations() noexcept { return thread_allocations; }
+
+void *operator new(std::size_t size) { return Allocate(size); }
+void *operator new[](std::size_t size) { return Allocate(size); }
+void *operator new(std::size_t size, std::align_val_t align) {
+  return AllocateAligned(size, align);
+}
+void *operator new[](std::size_t size, std::align_val_t align) {
+  return AllocateAligned(size, align);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
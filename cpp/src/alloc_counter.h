@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Number of heap allocations made by the calling thread so far. Counted by
+// the global operator new replacement in alloc_counter.cpp.
+uint64_t ThreadAllocations() noexcept;
+
+// Adds the allocations the current thread makes while the scope is alive to
+// *count
+class AllocationScope {
+  uint64_t *count_;
+  const uint64_t start_;
+
+public:
+  explicit AllocationScope(uint64_t *count)
+      : count_(count), start_(ThreadAllocations()) {}
+  ~AllocationScope() { *count_ += ThreadAllocations() - start_; }
+
+  AllocationScope(const AllocationScope &) = delete;
+  AllocationScope &operator=(const AllocationScope &) = delete;
+};
+
+// Allocations made by the echo handlers, folded in once per finished stream
+struct HandlerStats {
+  std::atomic<uint64_t> messages{0};
+  std::atomic<uint64_t> allocations{0};
+
+  static HandlerStats &Global() {
+    static HandlerStats stats;
+    return stats;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const HandlerStats &s) {
+    return os << "handler messages="
+              << s.messages.load(std::memory_order_relaxed)
+              << " allocations="
+              << s.allocations.load(std::memory_order_relaxed);
+  }
+};
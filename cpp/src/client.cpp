@@ -0,0 +1,462 @@
+#include <atomic>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <grpcpp/grpcpp.h>
+#include <iostream>
+#include <memory>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+#include "idle.h"
+#include "listener.h"
+#include "per_thread.h"
+#include "pingpong.grpc.pb.h"
+#include "shm_ring.h"
+
+using namespace pingpong;
+
+// Latency of the streams driven by one thread, in nanoseconds
+struct ClientLatency {
+  Histogram rtt;      // ping sent to pong received
+  Histogram request;  // ping sent to server timestamp
+  Histogram response; // server timestamp to pong received
+  Histogram intended; // scheduled send time to pong received (open loop)
+
+  void Merge(const ClientLatency &other) {
+    rtt.Merge(other.rtt);
+    request.Merge(other.request);
+    response.Merge(other.response);
+    intended.Merge(other.intended);
+  }
+
+  void SetDifference(const ClientLatency &now, const ClientLatency &before) {
+    rtt.SetDifference(now.rtt, before.rtt);
+    request.SetDifference(now.request, before.request);
+    response.SetDifference(now.response, before.response);
+    intended.SetDifference(now.intended, before.intended);
+  }
+
+  void Print(std::ostream &os) const {
+    rtt.Print(os, "rtt");
+    request.Print(os, "request");
+    response.Print(os, "response");
+    if (intended.Count() != 0) {
+      intended.Print(os, "intended");
+    }
+  }
+};
+
+struct ClientConfig {
+  std::string transport;
+  std::string target;
+  std::string shm_path;
+  int streams;
+  int payload;
+  double rate; // pings per second over all streams, 0 for closed loop
+  IdlePolicy idle;
+  std::shared_ptr<grpc::Channel> channel;
+};
+
+// Same clock as the server's timestamps
+static uint64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+}
+
+// Nanoseconds from then to now, 0 rather than wrapping around when the
+// clocks disagree
+static uint64_t Since(uint64_t then, uint64_t now) {
+  return now > then ? now - then : 0;
+}
+
+// Records one pong; one-way times assume the two clocks agree, which holds
+// on the same host up to the skew between cores
+static void RecordPong(const Pong &pong, uint64_t now) {
+  auto &latency = PerThread<ClientLatency>::Local();
+  latency.rtt.Record(Since(pong.timestamp(), now));
+  latency.request.Record(Since(pong.timestamp(), pong.server_timestamp()));
+  latency.response.Record(Since(pong.server_timestamp(), now));
+}
+
+// Transports carry one stream each. Send and Receive may be called from two
+// different threads, one each, so their buffers are kept apart.
+
+// Bidirectional gRPC stream on the shared channel
+class GrpcTransport {
+  std::unique_ptr<PingPong::Stub> stub_;
+  grpc::ClientContext context_;
+  std::unique_ptr<grpc::ClientReaderWriter<Ping, Pong>> stream_;
+
+public:
+  explicit GrpcTransport(const ClientConfig &config)
+      : stub_(PingPong::NewStub(config.channel)) {}
+
+  ~GrpcTransport() {
+    if (stream_) {
+      stream_->WritesDone();
+      stream_->Finish();
+    }
+  }
+
+  bool Connect(int, const ClientConfig &) {
+    stream_ = stub_->StreamPingPong(&context_);
+    return stream_ != nullptr;
+  }
+
+  bool Send(const Ping &ping) { return stream_->Write(ping); }
+
+  bool Receive(Pong *pong) { return stream_->Read(pong); }
+};
+
+// Stream over one shared memory segment of the server's --shm-streams
+class ShmTransport {
+  std::unique_ptr<shm::Channel> channel_;
+  const IdlePolicy idle_;
+  std::string request_;
+  std::string reply_;
+
+public:
+  explicit ShmTransport(const ClientConfig &config) : idle_(config.idle) {}
+
+  ~ShmTransport() {
+    // Ends the session so the server frees the segment for the next client
+    if (channel_) {
+      channel_->Close();
+    }
+  }
+
+  bool Connect(int id, const ClientConfig &config) {
+    channel_ = shm::Channel::Attach(config.shm_path + "." + std::to_string(id));
+    return channel_ != nullptr;
+  }
+
+  bool Send(const Ping &ping) {
+    ping.SerializeToString(&request_);
+    return channel_->requests().Write(request_.data(), request_.size(),
+                                      idle_);
+  }
+
+  bool Receive(Pong *pong) {
+    return channel_->replies().Read(&reply_, idle_) &&
+           pong->ParseFromString(reply_);
+  }
+};
+
+// Connection to the uring engine: wire bytes behind a 4 byte little-endian
+// length over a unix socket
+class FrameTransport {
+  int fd_{-1};
+  std::string request_;
+  std::string reply_;
+
+  bool ReadFully(void *data, size_t size) {
+    for (size_t done = 0; done < size;) {
+      const ssize_t n =
+          read(fd_, static_cast<char *>(data) + done, size - done);
+      if (n <= 0) {
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+public:
+  explicit FrameTransport(const ClientConfig &) {}
+
+  ~FrameTransport() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool Connect(int, const ClientConfig &config) {
+    sockaddr_un addr;
+    socklen_t len;
+    if (!UnixAddress(config.target, &addr, &len)) {
+      return false;
+    }
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    return fd_ >= 0 &&
+           connect(fd_, reinterpret_cast<sockaddr *>(&addr), len) == 0;
+  }
+
+  bool Send(const Ping &ping) {
+    const uint32_t size = ping.ByteSizeLong();
+    request_.resize(sizeof(size) + size);
+    std::memcpy(request_.data(), &size, sizeof(size));
+    ping.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8_t *>(request_.data() + sizeof(size)));
+    for (size_t done = 0; done < request_.size();) {
+      const ssize_t n = send(fd_, request_.data() + done,
+                             request_.size() - done, MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  bool Receive(Pong *pong) {
+    uint32_t size;
+    if (!ReadFully(&size, sizeof(size))) {
+      return false;
+    }
+    reply_.resize(size);
+    return ReadFully(reply_.data(), size) && pong->ParseFromString(reply_);
+  }
+};
+
+struct RunState {
+  const std::atomic<bool> &stop;
+  std::atomic<bool> &failed;
+
+  void Fail(int id, const char *what) {
+    std::cerr << "Stream " + std::to_string(id) + " " + what + "\n";
+    failed.store(true);
+  }
+};
+
+// Closed loop over one stream: send a ping, wait for its pong, repeat
+template <typename Transport>
+static void RunClosedLoop(int id, Transport &transport,
+                          const ClientConfig &config, RunState &state) {
+  Ping ping;
+  Pong pong;
+  ping.set_payload(std::string(config.payload, 'x'));
+  for (uint64_t seq = 1; !state.stop.load(std::memory_order_relaxed); ++seq) {
+    ping.set_sequence(seq);
+    ping.set_timestamp(Now());
+    if (!transport.Send(ping) || !transport.Receive(&pong)) {
+      state.Fail(id, "closed by server");
+      return;
+    }
+    const uint64_t now = Now();
+    if (pong.sequence() != seq) {
+      state.Fail(id, "got a pong out of order");
+      return;
+    }
+    RecordPong(pong, now);
+  }
+}
+
+// Sleeps until close to the deadline, then spins the rest of the way
+static void WaitUntil(uint64_t deadline) {
+  constexpr uint64_t kSpinNanos = 50000;
+  const uint64_t now = Now();
+  if (now + kSpinNanos < deadline) {
+    std::this_thread::sleep_for(
+        std::chrono::nanoseconds(deadline - now - kSpinNanos));
+  }
+  while (Now() < deadline) {
+    CpuRelax();
+  }
+}
+
+// Open loop over one stream: pings leave on a fixed schedule whether or not
+// earlier pongs came back, and latency is also taken from each ping's
+// scheduled send time, so a stalled server shows up in full instead of
+// silently slowing the client down (coordinated omission).
+template <typename Transport>
+static void RunOpenLoop(int id, Transport &transport,
+                        const ClientConfig &config, RunState &state) {
+  const uint64_t period = config.streams * 1e9 / config.rate;
+  // Streams are staggered across one period
+  const uint64_t start = Now() + id * period / config.streams;
+  std::atomic<uint64_t> sent{0};
+  std::atomic<bool> sending{true};
+
+  std::thread receiver([&]() {
+    Pong pong;
+    for (uint64_t seq = 1;; ++seq) {
+      // Every ping sent is answered before the stream ends
+      while (seq > sent.load(std::memory_order_acquire)) {
+        if (!sending.load(std::memory_order_acquire) &&
+            seq > sent.load(std::memory_order_acquire)) {
+          return;
+        }
+        std::this_thread::yield();
+      }
+      if (!transport.Receive(&pong)) {
+        state.Fail(id, "closed by server");
+        return;
+      }
+      const uint64_t now = Now();
+      if (pong.sequence() != seq) {
+        state.Fail(id, "got a pong out of order");
+        return;
+      }
+      RecordPong(pong, now);
+      PerThread<ClientLatency>::Local().intended.Record(
+          now - (start + (seq - 1) * period));
+    }
+  });
+
+  Ping ping;
+  ping.set_payload(std::string(config.payload, 'x'));
+  for (uint64_t seq = 1; !state.stop.load(std::memory_order_relaxed) &&
+                         !state.failed.load(std::memory_order_relaxed);
+       ++seq) {
+    WaitUntil(start + (seq - 1) * period);
+    ping.set_sequence(seq);
+    ping.set_timestamp(Now());
+    if (!transport.Send(ping)) {
+      state.Fail(id, "closed by server");
+      break;
+    }
+    sent.store(seq, std::memory_order_release);
+  }
+  sending.store(false, std::memory_order_release);
+  receiver.join();
+}
+
+template <typename Transport>
+static void RunStream(int id, const ClientConfig &config, RunState &state) {
+  Transport transport(config);
+  if (!transport.Connect(id, config)) {
+    state.Fail(id, "failed to connect");
+    return;
+  }
+  if (config.rate > 0) {
+    RunOpenLoop(id, transport, config, state);
+  } else {
+    RunClosedLoop(id, transport, config, state);
+  }
+}
+
+static std::unique_ptr<ClientLatency> Snapshot() {
+  auto total = std::make_unique<ClientLatency>();
+  PerThread<ClientLatency>::ForEach(
+      [&total](const ClientLatency &l) { total->Merge(l); });
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  namespace po = boost::program_options;
+  po::options_description desc("Allowed options");
+  desc.add_options()(
+      "transport", po::value<std::string>()->default_value("grpc"),
+      "grpc, shm for the server's shared memory streams, or frame for its "
+      "uring engine")(
+      "target",
+      po::value<std::string>()->default_value("unix:///tmp/pingpong.sock"),
+      "Server address; the uring engine takes unix targets only")(
+      "shm-path", po::value<std::string>()->default_value("/dev/shm/pingpong"),
+      "Prefix of the server's shared memory segment files")(
+      "streams", po::value<int>()->default_value(1),
+      "Concurrent streams, one thread and connection or segment each")(
+      "payload", po::value<int>()->default_value(0), "Payload size in bytes")(
+      "max-message-size", po::value<int>()->default_value(16 * 1024),
+      "Largest gRPC message sent or accepted, in bytes")(
+      "rate", po::value<double>()->default_value(0),
+      "Open loop: pings per second over all streams; 0 runs a closed loop")(
+      "idle-spin", po::value<int>()->default_value(1000),
+      "Spin iterations before waiting on a futex, -1 never waits")(
+      "interval", po::value<int>()->default_value(5),
+      "Seconds between latency reports")(
+      "duration", po::value<int>()->default_value(0),
+      "Run time in seconds, 0 runs until interrupted")(
+      "hgrm-file", po::value<std::string>()->default_value(""),
+      "File to write the total latency distribution to, in HdrHistogram's "
+      "percentile format");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  ClientConfig config{.transport = vm["transport"].as<std::string>(),
+                      .target = vm["target"].as<std::string>(),
+                      .shm_path = vm["shm-path"].as<std::string>(),
+                      .streams = vm["streams"].as<int>(),
+                      .payload = vm["payload"].as<int>(),
+                      .rate = vm["rate"].as<double>(),
+                      .idle = {.spin = vm["idle-spin"].as<int>()},
+                      .channel = nullptr};
+  const int interval = std::max(1, vm["interval"].as<int>());
+  const int duration = vm["duration"].as<int>();
+  const auto hgrm_file = vm["hgrm-file"].as<std::string>();
+  const int max_message_size = vm["max-message-size"].as<int>();
+  if (config.transport != "grpc" && config.transport != "shm" &&
+      config.transport != "frame") {
+    std::cerr << "Unknown transport: " << config.transport << "\n";
+    return 1;
+  }
+  if (config.streams < 1 || config.payload < 0 || config.rate < 0) {
+    std::cerr << "Invalid stream count, payload size or rate\n";
+    return 1;
+  }
+  if (config.transport == "grpc") {
+    grpc::ChannelArguments args;
+    args.SetMaxReceiveMessageSize(max_message_size);
+    args.SetMaxSendMessageSize(max_message_size);
+    config.channel = grpc::CreateCustomChannel(
+        config.target, grpc::InsecureChannelCredentials(), args);
+  }
+
+  // Signals are handled by the main thread, between reports
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  std::atomic<bool> stop{false};
+  std::atomic<bool> failed{false};
+  RunState state{.stop = stop, .failed = failed};
+  auto run = config.transport == "grpc"  ? RunStream<GrpcTransport>
+             : config.transport == "shm" ? RunStream<ShmTransport>
+                                         : RunStream<FrameTransport>;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < config.streams; ++i) {
+    threads.emplace_back(run, i, std::cref(config), std::ref(state));
+  }
+  std::cout << "Running " << config.streams << " " << config.transport
+            << " streams, payload " << config.payload << " bytes, ";
+  if (config.rate > 0) {
+    std::cout << "open loop at " << config.rate << " pings/s\n";
+  } else {
+    std::cout << "closed loop\n";
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  auto previous = std::make_unique<ClientLatency>();
+  while (!failed.load()) {
+    const timespec timeout{.tv_sec = interval, .tv_nsec = 0};
+    if (sigtimedwait(&signals, nullptr, &timeout) >= 0) {
+      break;
+    }
+    auto now = Snapshot();
+    ClientLatency delta;
+    delta.SetDifference(*now, *previous);
+    delta.Print(std::cout);
+    previous = std::move(now);
+    if (duration > 0 &&
+        std::chrono::steady_clock::now() - start >=
+            std::chrono::seconds(duration)) {
+      break;
+    }
+  }
+  stop.store(true);
+  for (auto &t : threads) {
+    t.join();
+  }
+  auto total = Snapshot();
+  std::cout << "total\n";
+  total->Print(std::cout);
+  std::cout << IdleStats::Global() << "\n";
+  if (!hgrm_file.empty()) {
+    // In the open loop the schedule-based latency is the one worth plotting
+    const Histogram &h = config.rate > 0 ? total->intended : total->rtt;
+    std::ofstream out(hgrm_file);
+    h.PrintDistribution(out, 1000);
+  }
+  return failed.load() ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+// Log-linear histogram in the style of HdrHistogram: values are bucketed by
+// power of two and each power is split into 64 linear sub-buckets, keeping
+// the relative error below 1.6% over the whole uint64 range. Record is meant
+// for a single writer and is wait-free; any thread may read concurrently.
+class Histogram {
+  static constexpr int kSubBucketBits = 7;
+  static constexpr uint64_t kSubBucketHalf = uint64_t{1}
+                                              << (kSubBucketBits - 1);
+  static constexpr size_t kBuckets = (64 - kSubBucketBits + 2) * kSubBucketHalf;
+
+  std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+  std::atomic<uint64_t> total_{0};
+  std::atomic<uint64_t> max_{0};
+
+  static size_t IndexOf(uint64_t value) noexcept {
+    const int msb = 63 - std::countl_zero(value | 1);
+    const int shift = std::max(0, msb - kSubBucketBits + 1);
+    return shift * kSubBucketHalf + (value >> shift);
+  }
+
+  // Highest value that lands in bucket index
+  static uint64_t ValueOf(size_t index) noexcept {
+    const int shift =
+        std::max<int>(0, static_cast<int>(index / kSubBucketHalf) - 1);
+    const uint64_t sub = index - shift * kSubBucketHalf;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  static void Add(std::atomic<uint64_t> &counter, uint64_t n) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+  }
+
+public:
+  // Single writer only
+  void Record(uint64_t value) noexcept {
+    Add(counts_[IndexOf(value)], 1);
+    Add(total_, 1);
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  // Adds other into this one, which must not be recorded into concurrently
+  void Merge(const Histogram &other) noexcept {
+    for (size_t i = 0; i < kBuckets; ++i) {
+      Add(counts_[i], other.counts_[i].load(std::memory_order_relaxed));
+    }
+    Add(total_, other.total_.load(std::memory_order_relaxed));
+    max_.store(std::max(max_.load(std::memory_order_relaxed),
+                        other.max_.load(std::memory_order_relaxed)),
+               std::memory_order_relaxed);
+  }
+
+  // Replaces this one with the values recorded in now since before. The max
+  // becomes the upper bound of the highest non-empty bucket.
+  void SetDifference(const Histogram &now, const Histogram &before) noexcept {
+    uint64_t total = 0;
+    uint64_t max = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      const uint64_t n = now.counts_[i].load(std::memory_order_relaxed) -
+                         before.counts_[i].load(std::memory_order_relaxed);
+      counts_[i].store(n, std::memory_order_relaxed);
+      total += n;
+      if (n != 0) {
+        max = ValueOf(i);
+      }
+    }
+    total_.store(total, std::memory_order_relaxed);
+    max_.store(std::min(max, now.Max()), std::memory_order_relaxed);
+  }
+
+  void CopyFrom(const Histogram &other) noexcept {
+    for (size_t i = 0; i < kBuckets; ++i) {
+      counts_[i].store(other.counts_[i].load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    }
+    total_.store(other.Count(), std::memory_order_relaxed);
+    max_.store(other.Max(), std::memory_order_relaxed);
+  }
+
+  uint64_t Count() const noexcept {
+    return total_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t Max() const noexcept { return max_.load(std::memory_order_relaxed); }
+
+  uint64_t ValueAtPercentile(double percentile) const noexcept {
+    const uint64_t total = Count();
+    if (total == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+    rank = std::clamp<uint64_t>(rank, 1, total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += counts_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return std::min(ValueOf(i), Max());
+      }
+    }
+    return Max();
+  }
+
+  // One line summary, values in microseconds
+  void Print(std::ostream &os, const char *name) const {
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+    os << name << " count=" << Count() << " p50=" << us(ValueAtPercentile(50))
+       << "us p90=" << us(ValueAtPercentile(90))
+       << "us p99=" << us(ValueAtPercentile(99))
+       << "us p99.9=" << us(ValueAtPercentile(99.9)) << "us max=" << us(Max())
+       << "us\n";
+  }
+
+  // Percentile distribution in HdrHistogram's text format, one line per
+  // non-empty bucket, as read by its plotting tools; values are divided by
+  // unit (1000 prints nanoseconds as microseconds)
+  void PrintDistribution(std::ostream &os, double unit) const {
+    const uint64_t total = Count();
+    char line[128];
+    os << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+    uint64_t seen = 0;
+    double sum = 0;
+    double sum_squares = 0;
+    for (size_t i = 0; i < kBuckets && seen < total; ++i) {
+      const uint64_t n = counts_[i].load(std::memory_order_relaxed);
+      if (n == 0) {
+        continue;
+      }
+      seen += n;
+      const double value = std::min(ValueOf(i), Max()) / unit;
+      sum += value * n;
+      sum_squares += value * value * n;
+      const double percentile = static_cast<double>(seen) / total;
+      if (seen < total) {
+        std::snprintf(line, sizeof(line), "%12.3f %14.12f %10lu %14.2f\n",
+                      value, percentile, static_cast<unsigned long>(seen),
+                      1 / (1 - percentile));
+      } else {
+        std::snprintf(line, sizeof(line), "%12.3f %14.12f %10lu\n", value,
+                      percentile, static_cast<unsigned long>(seen));
+      }
+      os << line;
+    }
+    const double mean = total == 0 ? 0 : sum / total;
+    const double deviation =
+        total == 0 ? 0 : std::sqrt(sum_squares / total - mean * mean);
+    std::snprintf(line, sizeof(line),
+                  "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean,
+                  deviation);
+    os << line;
+    std::snprintf(line, sizeof(line),
+                  "#[Max     = %12.3f, Total count    = %12lu]\n",
+                  Max() / unit, static_cast<unsigned long>(total));
+    os << line;
+    std::snprintf(line, sizeof(line),
+                  "#[Buckets = %12lu, SubBuckets     = %12lu]\n",
+                  static_cast<unsigned long>(kBuckets / kSubBucketHalf),
+                  static_cast<unsigned long>(2 * kSubBucketHalf));
+    os << line;
+  }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <grpc/grpc.h>
+#include <grpcpp/server_builder.h>
+#include <ostream>
+
+// HTTP/2 transport parameters of the server, applied as channel arguments.
+// Fields left at -1 keep gRPC's defaults.
+struct Http2Settings {
+  // Initial stream window advertised to clients, in bytes
+  int stream_window{-1};
+  // Bandwidth-delay probing, which otherwise grows the windows on its own
+  int bdp_probe{-1};
+  // Largest frame the server accepts, in bytes
+  int max_frame_size{-1};
+  int max_concurrent_streams{-1};
+  // Interval of keepalive pings and how long to wait for their ack
+  int keepalive_ms{-1};
+  int keepalive_timeout_ms{-1};
+  // Bytes a stream may buffer for writing before the transport flushes
+  int write_buffer_size{-1};
+
+  bool Valid() const {
+    // HTTP/2 bounds SETTINGS_MAX_FRAME_SIZE to [2^14, 2^24 - 1]
+    return (max_frame_size == -1 ||
+            (max_frame_size >= 16384 && max_frame_size <= 16777215)) &&
+           stream_window >= -1 && bdp_probe >= -1 && bdp_probe <= 1 &&
+           max_concurrent_streams >= -1 && keepalive_ms >= -1 &&
+           keepalive_timeout_ms >= -1 && write_buffer_size >= -1;
+  }
+
+  void Apply(grpc::ServerBuilder &builder) const {
+    auto set = [&builder](const char *arg, int value) {
+      if (value >= 0) {
+        builder.AddChannelArgument(arg, value);
+      }
+    };
+    set(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES, stream_window);
+    set(GRPC_ARG_HTTP2_BDP_PROBE, bdp_probe);
+    set(GRPC_ARG_HTTP2_MAX_FRAME_SIZE, max_frame_size);
+    set(GRPC_ARG_MAX_CONCURRENT_STREAMS, max_concurrent_streams);
+    set(GRPC_ARG_KEEPALIVE_TIME_MS, keepalive_ms);
+    set(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, keepalive_timeout_ms);
+    set(GRPC_ARG_HTTP2_WRITE_BUFFER_SIZE, write_buffer_size);
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const Http2Settings &s) {
+    auto print = [&os](const char *name, int value) {
+      os << " " << name << "=";
+      if (value >= 0) {
+        os << value;
+      } else {
+        os << "default";
+      }
+    };
+    os << "HTTP/2";
+    print("stream_window", s.stream_window);
+    print("bdp_probe", s.bdp_probe);
+    print("max_frame_size", s.max_frame_size);
+    print("max_concurrent_streams", s.max_concurrent_streams);
+    print("keepalive_ms", s.keepalive_ms);
+    print("keepalive_timeout_ms", s.keepalive_timeout_ms);
+    print("write_buffer_size", s.write_buffer_size);
+    return os;
+  }
+};
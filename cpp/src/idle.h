@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <ostream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// How an idle fiber thread waits for work: spin this many iterations with a
+// pause instruction first, then park on a futex. A negative spin count never
+// parks.
+struct IdlePolicy {
+  int spin{1000};
+};
+
+// Process wide counters of how idle waits ended
+struct IdleStats {
+  std::atomic<uint64_t> spins{0};   // wait satisfied while spinning
+  std::atomic<uint64_t> parks{0};   // wait went to sleep in the kernel
+  std::atomic<uint64_t> wakeups{0}; // notify had to wake a parked thread
+
+  static IdleStats &Global() {
+    static IdleStats stats;
+    return stats;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const IdleStats &s) {
+    return os << "idle spins=" << s.spins.load(std::memory_order_relaxed)
+              << " parks=" << s.parks.load(std::memory_order_relaxed)
+              << " wakeups=" << s.wakeups.load(std::memory_order_relaxed);
+  }
+};
+
+inline void CpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Wakeup slot for one thread. A notification is a sticky permit: it wakes
+// the current Wait, or the next one if none is in progress. Notifications
+// before a Wait takes the permit collapse into one, so waiters recheck their
+// condition after waking.
+class Parker {
+  static constexpr uint32_t kEmpty = 0;
+  static constexpr uint32_t kNotified = 1;
+  static constexpr uint32_t kParked = 2;
+
+  alignas(64) std::atomic<uint32_t> state_{kEmpty};
+
+  // Takes the permit, if there is one
+  bool Consume() noexcept {
+    uint32_t expected = kNotified;
+    return state_.compare_exchange_strong(expected, kEmpty,
+                                          std::memory_order_acquire);
+  }
+
+  // steady_clock is CLOCK_MONOTONIC, so deadlines map onto an absolute
+  // FUTEX_WAIT_BITSET timeout
+  void FutexWait(std::chrono::steady_clock::time_point const &deadline) {
+    timespec ts{};
+    timespec *timeout = nullptr;
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    deadline.time_since_epoch())
+                    .count();
+      ts.tv_sec = ns / 1000000000;
+      ts.tv_nsec = ns % 1000000000;
+      timeout = &ts;
+    }
+    syscall(SYS_futex, &state_, FUTEX_WAIT_BITSET_PRIVATE, kParked, timeout,
+            nullptr, FUTEX_BITSET_MATCH_ANY);
+  }
+
+public:
+  // Returns once notified or when the deadline passes
+  void Wait(std::chrono::steady_clock::time_point const &deadline,
+            const IdlePolicy &policy) noexcept {
+    const bool timed = deadline != std::chrono::steady_clock::time_point::max();
+    for (int i = 0; policy.spin < 0 || i < policy.spin; ++i) {
+      if (Consume()) {
+        IdleStats::Global().spins.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      if (timed && (i & 63) == 0 &&
+          std::chrono::steady_clock::now() >= deadline) {
+        return;
+      }
+      CpuRelax();
+    }
+
+    uint32_t expected = kEmpty;
+    if (!state_.compare_exchange_strong(expected, kParked,
+                                        std::memory_order_acquire)) {
+      // Notified in between
+      Consume();
+      IdleStats::Global().spins.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    IdleStats::Global().parks.fetch_add(1, std::memory_order_relaxed);
+    while (state_.load(std::memory_order_acquire) == kParked) {
+      if (timed && std::chrono::steady_clock::now() >= deadline) {
+        break;
+      }
+      FutexWait(deadline);
+    }
+    // Either consumes the notification or withdraws after a timeout
+    state_.exchange(kEmpty, std::memory_order_acquire);
+  }
+
+  void Notify() noexcept {
+    if (state_.exchange(kNotified, std::memory_order_release) == kParked) {
+      IdleStats::Global().wakeups.fetch_add(1, std::memory_order_relaxed);
+      syscall(SYS_futex, &state_, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+  }
+};
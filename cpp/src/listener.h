@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <grpcpp/server.h>
+#include <grpcpp/server_posix.h>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// One --listen value: a gRPC server address (unix:///path, unix-abstract:name,
+// host:port, [v6addr]:port, optionally prefixed with ipv4: or ipv6:) followed
+// by comma separated socket options for TCP targets, e.g.
+// "127.0.0.1:50051,nodelay=0,sndbuf=262144,rcvbuf=262144"
+struct ListenSpec {
+  std::string target;
+  // On unless nodelay=0. gRPC sets TCP_NODELAY while setting up its own
+  // listeners, which a tuned listener's connections bypass, so Tune sets it
+  // on every accepted socket.
+  int nodelay{1};
+  int sndbuf{0}; // 0 leaves the kernel default
+  int rcvbuf{0};
+
+  bool IsUnix() const {
+    return target.starts_with("unix:") || target.starts_with("unix-abstract:");
+  }
+
+  // Whether gRPC's own listener would not do: nodelay=1 is its default
+  bool Tuned() const { return nodelay == 0 || sndbuf > 0 || rcvbuf > 0; }
+
+  // Address of shard index out of count: unix sockets get a per-shard name,
+  // TCP ports are shared through SO_REUSEPORT
+  std::string ShardTarget(int index, int count) const {
+    if (count > 1 && IsUnix()) {
+      return target + "." + std::to_string(index);
+    }
+    return target;
+  }
+
+  static bool Parse(const std::string &value, ListenSpec *spec) {
+    std::stringstream ss(value);
+    std::string part;
+    if (!std::getline(ss, spec->target, ',') || spec->target.empty()) {
+      return false;
+    }
+    for (const char *prefix : {"ipv4:", "ipv6:"}) {
+      if (spec->target.starts_with(prefix)) {
+        spec->target.erase(0, std::strlen(prefix));
+      }
+    }
+    bool options = false;
+    while (std::getline(ss, part, ',')) {
+      options = true;
+      const size_t eq = part.find('=');
+      if (eq == std::string::npos) {
+        return false;
+      }
+      const std::string key = part.substr(0, eq);
+      int value;
+      try {
+        value = std::stoi(part.substr(eq + 1));
+      } catch (const std::exception &) {
+        return false;
+      }
+      if (key == "nodelay") {
+        spec->nodelay = value != 0;
+      } else if (key == "sndbuf" && value > 0) {
+        spec->sndbuf = value;
+      } else if (key == "rcvbuf" && value > 0) {
+        spec->rcvbuf = value;
+      } else {
+        return false;
+      }
+    }
+    return !(options && spec->IsUnix());
+  }
+};
+
+// Socket address of a unix:path, unix:///path or unix-abstract:name target
+inline bool UnixAddress(const std::string &target, sockaddr_un *addr,
+                        socklen_t *len) {
+  *addr = {};
+  addr->sun_family = AF_UNIX;
+  std::string path;
+  size_t offset = 0;
+  if (target.starts_with("unix-abstract:")) {
+    path = target.substr(std::strlen("unix-abstract:"));
+    // Abstract names start with a NUL byte and are not NUL terminated
+    offset = 1;
+  } else if (target.starts_with("unix://")) {
+    path = target.substr(std::strlen("unix://"));
+  } else if (target.starts_with("unix:")) {
+    path = target.substr(std::strlen("unix:"));
+  } else {
+    return false;
+  }
+  if (path.empty() || offset + path.size() >= sizeof(addr->sun_path)) {
+    return false;
+  }
+  std::memcpy(addr->sun_path + offset, path.data(), path.size());
+  // The path's terminating NUL, or the abstract name's leading one
+  *len = offsetof(sockaddr_un, sun_path) + path.size() + 1;
+  return true;
+}
+
+// Listening socket for a unix target outside of gRPC, -1 on failure. A stale
+// socket file is replaced.
+inline int ListenUnix(const std::string &target) {
+  sockaddr_un addr;
+  socklen_t len;
+  if (!UnixAddress(target, &addr, &len)) {
+    return -1;
+  }
+  if (addr.sun_path[0] != '\0') {
+    unlink(addr.sun_path);
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// gRPC exposes no per-port socket options, so a tuned TCP listener accepts
+// connections itself, applies the options and hands each socket to the
+// server as an already connected channel.
+class TunedListener {
+  const ListenSpec spec_;
+  int fd_{-1};
+  std::atomic<bool> stopping_{false};
+  std::thread acceptor_;
+
+  void Tune(int fd) const {
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &spec_.nodelay,
+               sizeof(spec_.nodelay));
+    if (spec_.sndbuf > 0) {
+      setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &spec_.sndbuf,
+                 sizeof(spec_.sndbuf));
+    }
+    if (spec_.rcvbuf > 0) {
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &spec_.rcvbuf,
+                 sizeof(spec_.rcvbuf));
+    }
+  }
+
+  // Keeps accepting until Stop. Other failures, such as running out of file
+  // descriptors or memory, are logged once per streak and retried after a
+  // pause, so the listener outlives them.
+  void Accept(grpc::Server *server) {
+    bool failing = false;
+    for (;;) {
+      // gRPC's endpoints expect a non-blocking fd
+      const int fd =
+          accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if (fd < 0) {
+        const int error = errno;
+        if (stopping_.load(std::memory_order_relaxed)) {
+          return;
+        }
+        if (error == EINTR || error == ECONNABORTED) {
+          continue;
+        }
+        if (!failing) {
+          std::cerr << "Accepting on " + spec_.target +
+                           " failed: " + std::strerror(error) +
+                           ", retrying\n";
+          failing = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        continue;
+      }
+      if (failing) {
+        std::cerr << "Accepting on " + spec_.target + " resumed\n";
+        failing = false;
+      }
+      Tune(fd);
+      grpc::AddInsecureChannelFromFd(server, fd);
+    }
+  }
+
+public:
+  explicit TunedListener(const ListenSpec &spec) : spec_(spec) {}
+
+  ~TunedListener() { Stop(); }
+
+  // Binds and listens, with SO_REUSEPORT so shards may share the port
+  bool Listen() {
+    std::string host = spec_.target;
+    const size_t colon = host.rfind(':');
+    if (colon == std::string::npos) {
+      return false;
+    }
+    const std::string port = host.substr(colon + 1);
+    host.resize(colon);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+      host = host.substr(1, host.size() - 2);
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo *result;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                    &hints, &result) != 0) {
+      return false;
+    }
+    for (addrinfo *ai = result; ai != nullptr; ai = ai->ai_next) {
+      const int fd =
+          socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        continue;
+      }
+      const int on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+      // Accepted sockets inherit the listener's buffer sizes
+      Tune(fd);
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+          listen(fd, SOMAXCONN) == 0) {
+        fd_ = fd;
+        break;
+      }
+      close(fd);
+    }
+    freeaddrinfo(result);
+    return fd_ >= 0;
+  }
+
+  void Start(grpc::Server *server) {
+    acceptor_ = std::thread(&TunedListener::Accept, this, server);
+  }
+
+  void Stop() {
+    if (fd_ < 0) {
+      return;
+    }
+    stopping_.store(true, std::memory_order_relaxed);
+    // Wakes the acceptor out of accept()
+    shutdown(fd_, SHUT_RDWR);
+    if (acceptor_.joinable()) {
+      acceptor_.join();
+    }
+    close(fd_);
+    fd_ = -1;
+  }
+};
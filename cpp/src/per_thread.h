@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One T per thread, readable from any thread through ForEach. Instances
+// outlive their thread so nothing recorded is lost, and are handed on to the
+// next new thread so thread churn does not grow the list.
+template <typename T> class PerThread {
+  struct Node {
+    T value{};
+    bool in_use{false};
+  };
+
+  struct Registry {
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Node>> nodes;
+  };
+
+  static Registry &registry() {
+    static Registry registry;
+    return registry;
+  }
+
+  class Handle {
+    Node *node_;
+
+  public:
+    Handle() {
+      auto &r = registry();
+      std::lock_guard<std::mutex> lk(r.mtx);
+      for (auto &node : r.nodes) {
+        if (!node->in_use) {
+          node_ = node.get();
+          node_->in_use = true;
+          return;
+        }
+      }
+      r.nodes.push_back(std::make_unique<Node>());
+      node_ = r.nodes.back().get();
+      node_->in_use = true;
+    }
+
+    ~Handle() {
+      std::lock_guard<std::mutex> lk(registry().mtx);
+      node_->in_use = false;
+    }
+
+    T &value() noexcept { return node_->value; }
+  };
+
+public:
+  static T &Local() {
+    thread_local Handle handle;
+    return handle.value();
+  }
+
+  template <typename F> static void ForEach(F &&f) {
+    auto &r = registry();
+    std::lock_guard<std::mutex> lk(r.mtx);
+    for (auto &node : r.nodes) {
+      f(static_cast<const T &>(node->value));
+    }
+  }
+};
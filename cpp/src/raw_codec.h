@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/slice.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crc32c.h"
+
+// Hand-rolled wire codec for the raw echo path. It decodes the Ping fields
+// straight from the received slices and encodes a Pong as a small header
+// slice followed by references to the original payload slices, so neither
+// protobuf parsing nor a payload copy is involved.
+namespace raw {
+
+inline constexpr char kStreamPingPongMethod[] =
+    "/pingpong.PingPong/StreamPingPong";
+
+// Field numbers from proto/pingpong.proto
+inline constexpr uint32_t kPingSequence = 1;
+inline constexpr uint32_t kPingTimestamp = 2;
+inline constexpr uint32_t kPingPayload = 3;
+inline constexpr uint32_t kPingMore = 4;
+inline constexpr uint32_t kPingChecksum = 5;
+inline constexpr uint32_t kPongSequence = 1;
+inline constexpr uint32_t kPongTimestamp = 2;
+inline constexpr uint32_t kPongServerTimestamp = 3;
+inline constexpr uint32_t kPongPayload = 4;
+inline constexpr uint32_t kPongMore = 5;
+inline constexpr uint32_t kPongWorkResult = 6;
+inline constexpr uint32_t kPongChecksum = 7;
+
+inline constexpr uint32_t kWireVarint = 0;
+inline constexpr uint32_t kWireFixed64 = 1;
+inline constexpr uint32_t kWireLengthDelimited = 2;
+inline constexpr uint32_t kWireFixed32 = 5;
+
+// Byte cursor over a sequence of slices
+class SliceReader {
+  const std::vector<grpc::Slice> &slices_;
+  size_t index_{0};
+  size_t offset_{0};
+
+  void SkipEmpty() noexcept {
+    while (index_ < slices_.size() && offset_ == slices_[index_].size()) {
+      ++index_;
+      offset_ = 0;
+    }
+  }
+
+public:
+  explicit SliceReader(const std::vector<grpc::Slice> &slices)
+      : slices_(slices) {
+    SkipEmpty();
+  }
+
+  bool AtEnd() const noexcept { return index_ == slices_.size(); }
+
+  bool ReadByte(uint8_t *byte) noexcept {
+    if (AtEnd()) {
+      return false;
+    }
+    *byte = slices_[index_].begin()[offset_++];
+    SkipEmpty();
+    return true;
+  }
+
+  bool ReadVarint(uint64_t *value) noexcept {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte;
+      if (!ReadByte(&byte)) {
+        return false;
+      }
+      result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Appends references to the next n bytes to *out, or just skips them when
+  // out is null
+  bool Take(size_t n, std::vector<grpc::Slice> *out) {
+    while (n > 0) {
+      if (AtEnd()) {
+        return false;
+      }
+      const grpc::Slice &slice = slices_[index_];
+      const size_t chunk = std::min(n, slice.size() - offset_);
+      if (out != nullptr) {
+        out->push_back(slice.sub(offset_, offset_ + chunk));
+      }
+      offset_ += chunk;
+      n -= chunk;
+      SkipEmpty();
+    }
+    return true;
+  }
+};
+
+struct Ping {
+  uint64_t sequence{0};
+  uint64_t timestamp{0};
+  size_t payload_size{0};
+  std::vector<grpc::Slice> payload;
+  bool more{false};
+  std::optional<uint32_t> checksum;
+};
+
+// Decodes the wire slices of a Ping; unknown fields are skipped
+inline bool ParsePing(const std::vector<grpc::Slice> &wire, Ping *ping) {
+  ping->sequence = 0;
+  ping->timestamp = 0;
+  ping->payload_size = 0;
+  ping->payload.clear();
+  ping->more = false;
+  ping->checksum.reset();
+  SliceReader reader(wire);
+  while (!reader.AtEnd()) {
+    uint64_t key;
+    if (!reader.ReadVarint(&key)) {
+      return false;
+    }
+    const uint64_t field = key >> 3;
+    const uint32_t wire_type = key & 0x7;
+    uint64_t value;
+    switch (wire_type) {
+    case kWireVarint:
+      if (!reader.ReadVarint(&value)) {
+        return false;
+      }
+      if (field == kPingSequence) {
+        ping->sequence = value;
+      } else if (field == kPingTimestamp) {
+        ping->timestamp = value;
+      } else if (field == kPingMore) {
+        ping->more = value != 0;
+      }
+      break;
+    case kWireLengthDelimited:
+      if (!reader.ReadVarint(&value)) {
+        return false;
+      }
+      if (field == kPingPayload) {
+        // Last one wins, as in protobuf
+        ping->payload.clear();
+        ping->payload_size = value;
+        if (!reader.Take(value, &ping->payload)) {
+          return false;
+        }
+      } else if (!reader.Take(value, nullptr)) {
+        return false;
+      }
+      break;
+    case kWireFixed64:
+      if (!reader.Take(8, nullptr)) {
+        return false;
+      }
+      break;
+    case kWireFixed32:
+      if (field == kPingChecksum) {
+        uint8_t bytes[4];
+        for (uint8_t &byte : bytes) {
+          if (!reader.ReadByte(&byte)) {
+            return false;
+          }
+        }
+        uint32_t checksum;
+        std::memcpy(&checksum, bytes, sizeof(checksum)); // little endian
+        ping->checksum = checksum;
+      } else if (!reader.Take(4, nullptr)) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+// The payload as one contiguous view: the slice itself when it came in one,
+// else a copy gathered into *buffer
+inline std::string_view FlatPayload(const Ping &ping, std::string *buffer) {
+  if (ping.payload.size() == 1) {
+    const grpc::Slice &slice = ping.payload.front();
+    return {reinterpret_cast<const char *>(slice.begin()), slice.size()};
+  }
+  buffer->clear();
+  for (const grpc::Slice &slice : ping.payload) {
+    buffer->append(reinterpret_cast<const char *>(slice.begin()),
+                   slice.size());
+  }
+  return *buffer;
+}
+
+// CRC32C of the payload, chained over its slices
+inline uint32_t PayloadChecksum(const Ping &ping) noexcept {
+  uint32_t crc = 0;
+  for (const grpc::Slice &slice : ping.payload) {
+    crc = crc32c::Extend(crc, slice.begin(), slice.size());
+  }
+  return crc;
+}
+
+inline uint8_t *PutVarint(uint8_t *p, uint64_t value) noexcept {
+  while (value >= 0x80) {
+    *p++ = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  *p++ = static_cast<uint8_t>(value);
+  return p;
+}
+
+inline uint8_t *PutVarintField(uint8_t *p, uint32_t field,
+                               uint64_t value) noexcept {
+  // proto3 leaves zero scalars off the wire
+  if (value == 0) {
+    return p;
+  }
+  p = PutVarint(p, (field << 3) | kWireVarint);
+  return PutVarint(p, value);
+}
+
+// Replaces *out with the wire slices of the Pong answering ping
+inline void BuildPong(const Ping &ping, uint64_t server_timestamp,
+                      uint64_t work_result, std::optional<uint32_t> checksum,
+                      std::vector<grpc::Slice> *out) {
+  // Six keys and six varints at most, plus a key and a fixed32
+  uint8_t header[6 * (1 + 10) + 1 + 4];
+  uint8_t *p = header;
+  p = PutVarintField(p, kPongSequence, ping.sequence);
+  p = PutVarintField(p, kPongTimestamp, ping.timestamp);
+  p = PutVarintField(p, kPongServerTimestamp, server_timestamp);
+  // Ahead of the payload so the header stays one slice; fields may come in
+  // any order
+  p = PutVarintField(p, kPongMore, ping.more);
+  p = PutVarintField(p, kPongWorkResult, work_result);
+  if (checksum) {
+    // Presence is explicit, so a zero checksum goes on the wire too
+    p = PutVarint(p, (kPongChecksum << 3) | kWireFixed32);
+    std::memcpy(p, &*checksum, sizeof(*checksum)); // little endian
+    p += sizeof(*checksum);
+  }
+  if (ping.payload_size > 0) {
+    p = PutVarint(p, (kPongPayload << 3) | kWireLengthDelimited);
+    p = PutVarint(p, ping.payload_size);
+  }
+  out->clear();
+  out->emplace_back(header, p - header);
+  out->insert(out->end(), ping.payload.begin(), ping.payload.end());
+}
+
+} // namespace raw
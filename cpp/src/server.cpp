@@ -1,39 +1,74 @@
+#include <algorithm>
 #include <boost/fiber/all.hpp>
 #include <boost/program_options.hpp>
 #include <chrono>
+#include <csignal>
+#include <fstream>
+#include <google/protobuf/arena.h>
 #include <grpcpp/grpcpp.h>
+#include <latch>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include "affinity.h"
+#include "alloc_counter.h"
+#include "crc32c.h"
+#include "histogram.h"
+#include "http2_settings.h"
+#include "idle.h"
+#include "listener.h"
+#include "per_thread.h"
 #include "pingpong.grpc.pb.h"
+#include "raw_codec.h"
+#include "service_time.h"
+#include "shm_ring.h"
+#include "stream_messages.h"
+#include "timer_wheel.h"
+#include "tsc_clock.h"
+#include "uring.h"
+#include "work_kernel.h"
+#include "work_stealing.h"
 
 using std::condition_variable;
 using std::mutex;
 using std::unique_lock;
 
+using grpc::CompletionQueue;
 using grpc::Server;
+using grpc::ServerAsyncReaderWriter;
 using grpc::ServerBuilder;
+using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
 using grpc::ServerReaderWriter;
 using grpc::Status;
 using namespace pingpong;
 
-// Custom fiber scheduler optimized for RPC
+// Custom fiber scheduler optimized for RPC. Only the owning thread touches
+// the ready queue; other threads hand fibers over through the scheduler's
+// remote queue and wake this one via notify().
 class RPCScheduler : public boost::fibers::algo::algorithm {
 
   boost::fibers::scheduler::ready_queue_type rqueue_{};
-  mutable std::mutex mtx_{};
-  std::condition_variable cv_{};
-  bool flag_{false};
+  Parker parker_{};
+  FiberTimers timers_{};
+  const IdlePolicy policy_;
 
 public:
+  explicit RPCScheduler(const IdlePolicy &policy) : policy_(policy) {}
+
   void awakened(boost::fibers::context *ctx) noexcept override {
-    std::unique_lock<std::mutex> lk(mtx_);
     rqueue_.push_back(*ctx);
   }
 
   boost::fibers::context *pick_next() noexcept override {
-    std::unique_lock<std::mutex> lk(mtx_);
+    timers_.Expire();
     boost::fibers::context *ctx(nullptr);
     if (!rqueue_.empty()) {
       ctx = &rqueue_.front();
@@ -42,45 +77,267 @@ public:
     return ctx;
   }
 
-  bool has_ready_fibers() const noexcept override {
-    std::unique_lock<std::mutex> lk(mtx_);
-    return !rqueue_.empty();
-  }
+  bool has_ready_fibers() const noexcept override { return !rqueue_.empty(); }
 
   void suspend_until(std::chrono::steady_clock::time_point const
                          &time_point) noexcept override {
-    std::unique_lock<std::mutex> lk(mtx_);
-    if (!flag_) {
-      cv_.wait_until(lk, time_point);
-    }
+    parker_.Wait(timers_.Deadline(time_point), policy_);
   }
 
-  void notify() noexcept override {
-    std::unique_lock<std::mutex> lk(mtx_);
-    flag_ = true;
-    cv_.notify_all();
-  }
+  void notify() noexcept override { parker_.Notify(); }
 };
 
 struct ServerConfig {
+  std::string mode;
+  std::string scheduler;
+  std::string poll;
+  std::string codec;
+  std::string clock;
   bool use_fibers;
-  bool sleep;
+  bool duplex;
+  int max_batch;
+  int flush_us;
+  ServiceTime service_time;
+  std::shared_ptr<const WorkKernel> work;
   int num_threads;
-  std::string socket_path;
+  int num_pollers;
+  int shards;
+  int arena_reset;
+  IdlePolicy idle;
+  int stats_interval;
+  std::string stats_file;
+  std::vector<int> cpus;
+  int numa_node;
+  std::vector<ListenSpec> listeners;
+  int shm_streams;
+  std::string shm_path;
+  uint64_t shm_capacity;
+  Http2Settings http2;
+  int max_message_size;
+};
+
+// Handler latency of the streams served by one thread, in nanoseconds
+struct LatencyHistograms {
+  Histogram service;       // read completed to reply issued
+  Histogram inter_arrival; // between consecutive reads of a stream
+
+  void Merge(const LatencyHistograms &other) {
+    service.Merge(other.service);
+    inter_arrival.Merge(other.inter_arrival);
+  }
+};
+
+// Clocks of the handlers. The pongs' server_timestamp is wall clock time in
+// nanoseconds since the epoch, comparable with the client's; the handler
+// histograms time intervals on a monotonic clock, which wall clock steps do
+// not disturb. Both come from the system clocks, or with --clock=tsc from
+// the calibrated time stamp counter and a single rdtsc.
+class ServerClock {
+  static inline bool tsc_ = false;
+
+  static uint64_t Nanos(std::chrono::nanoseconds d) noexcept {
+    return d.count();
+  }
+
+public:
+  struct Reading {
+    uint64_t steady; // monotonic, in clock units
+    uint64_t wall;   // nanoseconds since the epoch
+  };
+
+  // False, leaving the system clocks in place, without an invariant TSC
+  static bool UseTsc() {
+    tsc_ = TscClock::Calibrate();
+    return tsc_;
+  }
+
+  // Period of Recalibrate, zero for the system clocks
+  static std::chrono::seconds RecalibrateEvery() noexcept {
+    return std::chrono::seconds(tsc_ ? 1 : 0);
+  }
+
+  // Follows NTP's adjustments of the wall clock
+  static void Recalibrate() noexcept {
+    if (tsc_) {
+      TscClock::Recalibrate();
+    }
+  }
+
+  // Monotonic reading: steady_clock nanoseconds or TSC ticks
+  static uint64_t Steady() noexcept {
+    if (tsc_) {
+      return TscClock::Ticks();
+    }
+    return Nanos(std::chrono::steady_clock::now().time_since_epoch());
+  }
+
+  static Reading Now() noexcept {
+    if (tsc_) {
+      const uint64_t ticks = TscClock::Ticks();
+      return {ticks, TscClock::Wall(ticks)};
+    }
+    return {Steady(),
+            Nanos(std::chrono::system_clock::now().time_since_epoch())};
+  }
+
+  // Nanoseconds between two steady readings; TSCs of different cores may
+  // disagree by a few ticks, so an earlier to gives 0
+  static uint64_t Between(uint64_t from, uint64_t to) noexcept {
+    if (to <= from) {
+      return 0;
+    }
+    return tsc_ ? TscClock::Nanos(to - from) : to - from;
+  }
+};
+
+// Times one stream into the calling thread's histograms
+class StreamLatency {
+  uint64_t read_{0}; // steady
+
+public:
+  // Returns the wall clock read time, which doubles as the pong's server
+  // timestamp
+  uint64_t Read() {
+    const ServerClock::Reading now = ServerClock::Now();
+    if (read_ != 0) {
+      PerThread<LatencyHistograms>::Local().inter_arrival.Record(
+          ServerClock::Between(read_, now.steady));
+    }
+    read_ = now.steady;
+    return now.wall;
+  }
+
+  void Write() {
+    PerThread<LatencyHistograms>::Local().service.Record(
+        ServerClock::Between(read_, ServerClock::Steady()));
+  }
+};
+
+// Merges the per-thread histograms and prints either what was recorded
+// since the previous interval or everything so far
+class LatencyReport {
+  std::unique_ptr<LatencyHistograms> previous_ =
+      std::make_unique<LatencyHistograms>();
+
+  static std::unique_ptr<LatencyHistograms> Snapshot() {
+    auto total = std::make_unique<LatencyHistograms>();
+    PerThread<LatencyHistograms>::ForEach(
+        [&total](const LatencyHistograms &h) { total->Merge(h); });
+    return total;
+  }
+
+public:
+  void PrintInterval(std::ostream &os) {
+    auto now = Snapshot();
+    LatencyHistograms interval;
+    interval.service.SetDifference(now->service, previous_->service);
+    interval.inter_arrival.SetDifference(now->inter_arrival,
+                                         previous_->inter_arrival);
+    if (interval.service.Count() != 0) {
+      interval.service.Print(os, "service");
+      interval.inter_arrival.Print(os, "inter_arrival");
+    }
+    previous_ = std::move(now);
+  }
+
+  void PrintTotal(std::ostream &os) {
+    auto total = Snapshot();
+    total->service.Print(os, "service");
+    total->inter_arrival.Print(os, "inter_arrival");
+  }
 };
 
+// Streams opened per client connection. Clients name their connection in
+// the pingpong-conn metadata entry; without it the peer address stands in,
+// which tells TCP connections apart but not unix socket ones.
+class ConnectionStats {
+  std::mutex mtx_;
+  std::unordered_map<std::string, uint64_t> streams_;
+
+public:
+  static ConnectionStats &Global() {
+    static ConnectionStats stats;
+    return stats;
+  }
+
+  void Record(const grpc::ServerContextBase &ctx) {
+    std::string key;
+    const auto &metadata = ctx.client_metadata();
+    if (auto it = metadata.find("pingpong-conn"); it != metadata.end()) {
+      key.assign(it->second.data(), it->second.size());
+    } else {
+      key = ctx.peer();
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    ++streams_[key];
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, ConnectionStats &s) {
+    std::lock_guard<std::mutex> lk(s.mtx_);
+    uint64_t total = 0;
+    uint64_t min = s.streams_.empty() ? 0 : UINT64_MAX;
+    uint64_t max = 0;
+    for (const auto &[key, streams] : s.streams_) {
+      total += streams;
+      min = std::min(min, streams);
+      max = std::max(max, streams);
+    }
+    return os << "connections count=" << s.streams_.size()
+              << " streams=" << total << " per_connection_min=" << min
+              << " per_connection_max=" << max;
+  }
+};
+
+// Simulated work of one message. Fibers wait in their thread's timer wheel
+// while the thread serves other streams; plain threads sleep.
+static void SimulateWork(const ServiceTime &service_time) {
+  if (!service_time.enabled()) {
+    return;
+  }
+  const auto duration = service_time.Sample();
+  if (!FiberTimers::Delay(duration)) {
+    std::this_thread::sleep_for(duration);
+  }
+}
+
 class PingPongService final : public PingPong::Service {
   const bool use_fibers_;
-  const bool sleep_;
+  const ServiceTime service_time_;
+  const WorkKernel *const work_;
+  const int arena_reset_;
+  const IdlePolicy idle_;
+  CpuAssigner &cpus_;
+
+  // gRPC recycles its threads across streams, so each thread is pinned and
+  // gets its fiber runtime on the first stream it serves, and keeps them
+  void InitThread() {
+    thread_local bool initialized = false;
+    if (initialized) {
+      return;
+    }
+    initialized = true;
+    if (const int cpu = cpus_.Next(); cpu >= 0) {
+      if (CpuAssigner::Pin(cpu)) {
+        std::cout << "grpc thread pinned to cpu " + std::to_string(cpu) + "\n";
+      }
+    }
+    if (use_fibers_) {
+      boost::fibers::use_scheduling_algorithm<RPCScheduler>(idle_);
+    }
+  }
 
 public:
-  explicit PingPongService(bool use_fibers, bool sleep)
-      : use_fibers_(use_fibers), sleep_(sleep) {}
+  PingPongService(bool use_fibers, const ServiceTime &service_time,
+                  const WorkKernel *work, int arena_reset,
+                  const IdlePolicy &idle, CpuAssigner &cpus)
+      : use_fibers_(use_fibers), service_time_(service_time), work_(work),
+        arena_reset_(arena_reset), idle_(idle), cpus_(cpus) {}
 
   Status StreamPingPong(ServerContext *context,
                         ServerReaderWriter<Pong, Ping> *stream) override {
+    InitThread();
+    ConnectionStats::Global().Record(*context);
     if (use_fibers_) {
-      boost::fibers::use_scheduling_algorithm<RPCScheduler>();
       return HandleStreamFiber(stream);
     }
     return HandleStreamThread(stream);
@@ -88,96 +345,1423 @@ public:
 
 private:
   Status HandleStreamFiber(ServerReaderWriter<Pong, Ping> *stream) {
-    const bool use_sleep = sleep_;
-    boost::fibers::fiber([use_sleep, stream]() {
-      Ping ping;
-      while (stream->Read(&ping)) {
-        if (use_sleep) {
-          boost::this_fiber::sleep_for(std::chrono::microseconds(4));
-        }
-        Pong pong;
-        pong.set_sequence(ping.sequence());
-        pong.set_timestamp(ping.timestamp());
-        pong.set_server_timestamp(
-            std::chrono::duration_cast<std::chrono::nanoseconds>(
-                std::chrono::high_resolution_clock::now().time_since_epoch())
-                .count());
-        pong.set_payload(ping.payload());
-
-        if (!stream->Write(pong)) {
+    const ServiceTime &service_time = service_time_;
+    const WorkKernel *work = work_;
+    const int arena_reset = arena_reset_;
+    boost::fibers::fiber([&service_time, work, arena_reset, stream]() {
+      StreamMessages msgs(arena_reset);
+      StreamLatency latency;
+      while (stream->Read(msgs.ping())) {
+        const uint64_t received = latency.Read();
+        SimulateWork(service_time);
+        msgs.Echo(received, work);
+        latency.Write();
+
+        if (!stream->Write(*msgs.pong())) {
           break;
         }
+        msgs.Recycle();
       }
     }).join();
     return Status::OK;
   }
 
   Status HandleStreamThread(ServerReaderWriter<Pong, Ping> *stream) {
-    Ping ping;
-    while (stream->Read(&ping)) {
-      if (sleep_) {
-        std::this_thread::sleep_for(std::chrono::microseconds(4));
-      }
-      Pong pong;
-      pong.set_sequence(ping.sequence());
-      pong.set_timestamp(ping.timestamp());
-      pong.set_server_timestamp(
-          std::chrono::duration_cast<std::chrono::nanoseconds>(
-              std::chrono::high_resolution_clock::now().time_since_epoch())
-              .count());
-      pong.set_payload(ping.payload());
+    StreamMessages msgs(arena_reset_);
+    StreamLatency latency;
+    while (stream->Read(msgs.ping())) {
+      const uint64_t received = latency.Read();
+      SimulateWork(service_time_);
+      msgs.Echo(received, work_);
+      latency.Write();
 
-      if (!stream->Write(pong)) {
+      if (!stream->Write(*msgs.pong())) {
         break;
       }
+      msgs.Recycle();
     }
     return Status::OK;
   }
 };
 
+// Completion queue tag that parks the issuing fiber until a poller thread
+// delivers the matching event
+class FiberTag {
+  boost::fibers::mutex mtx_{};
+  boost::fibers::condition_variable cv_{};
+  bool done_{false};
+  bool ok_{false};
+
+public:
+  void Complete(bool ok) noexcept {
+    std::unique_lock<boost::fibers::mutex> lk(mtx_);
+    ok_ = ok;
+    done_ = true;
+    cv_.notify_one();
+  }
+
+  bool Wait() {
+    std::unique_lock<boost::fibers::mutex> lk(mtx_);
+    cv_.wait(lk, [this]() { return done_; });
+    done_ = false;
+    return ok_;
+  }
+};
+
+// Async engine: every stream is a fiber suspended on its completion tag, so
+// a handful of worker threads multiplex any number of streams while poller
+// threads drain the completion queues and resume them. With the raw codec
+// streams arrive through the generic service as undecoded byte buffers.
+// Busy pollers never block in the completion queue, trading a core each for
+// not waking up in the kernel on every message.
+class AsyncPingPongServer {
+  struct Stream {
+    ServerContext ctx;
+    ServerAsyncReaderWriter<Pong, Ping> rw{&ctx};
+    FiberTag tag;
+  };
+
+  struct RawStream {
+    grpc::GenericServerContext ctx;
+    grpc::GenericServerAsyncReaderWriter rw{&ctx};
+    FiberTag tag;
+  };
+
+  PingPong::AsyncService service_;
+  grpc::AsyncGenericService generic_service_;
+  std::vector<std::unique_ptr<ServerCompletionQueue>> cqs_;
+  std::vector<std::thread> pollers_;
+  std::vector<std::thread> workers_;
+  std::unique_ptr<WorkStealingScheduler::Group> steal_group_;
+  const bool raw_;
+  const bool duplex_;
+  const int max_batch_;
+  const std::chrono::microseconds flush_delay_;
+  const bool busy_poll_;
+  const ServiceTime service_time_;
+  const WorkKernel *const work_;
+  const int arena_reset_;
+  const IdlePolicy idle_;
+  CpuAssigner &cpus_;
+  std::atomic<uint64_t> events_{0};
+  std::atomic<uint64_t> empty_polls_{0};
+  std::atomic<uint64_t> pongs_written_{0};
+  std::atomic<uint64_t> flushes_{0};
+
+  // Channel capacity of a duplex stream, it holds one less reply
+  static constexpr size_t kDuplexDepth = 64;
+
+public:
+  // Duplex writers coalesce up to max_batch pongs per flush, holding a
+  // partial batch back for up to flush_us from its first pong
+  AsyncPingPongServer(bool raw, bool duplex, int max_batch, int flush_us,
+                      bool busy_poll, const ServiceTime &service_time,
+                      const WorkKernel *work, int arena_reset,
+                      const IdlePolicy &idle, CpuAssigner &cpus)
+      : raw_(raw), duplex_(duplex), max_batch_(max_batch),
+        flush_delay_(flush_us), busy_poll_(busy_poll),
+        service_time_(service_time), work_(work), arena_reset_(arena_reset),
+        idle_(idle), cpus_(cpus) {}
+
+  void Register(ServerBuilder &builder, int num_pollers) {
+    if (raw_) {
+      builder.RegisterAsyncGenericService(&generic_service_);
+    } else {
+      builder.RegisterService(&service_);
+    }
+    for (int i = 0; i < num_pollers; ++i) {
+      cqs_.emplace_back(builder.AddCompletionQueue());
+    }
+  }
+
+  // Fiber threads use RPCScheduler each, or steal from each other when
+  // work_stealing is requested
+  void Start(int num_workers, bool work_stealing) {
+    if (work_stealing) {
+      steal_group_ =
+          std::make_unique<WorkStealingScheduler::Group>(num_workers, idle_);
+    }
+    for (size_t i = 0; i < cqs_.size(); ++i) {
+      const int cpu = cpus_.Next();
+      LogPlacement("poller", i, cpu);
+      pollers_.emplace_back(&AsyncPingPongServer::Poll, this, cqs_[i].get(),
+                            cpu);
+    }
+    for (int i = 0; i < num_workers; ++i) {
+      const int cpu = cpus_.Next();
+      LogPlacement("fiber worker", i, cpu);
+      workers_.emplace_back(&AsyncPingPongServer::Work, this, i,
+                            cqs_[i % cqs_.size()].get(), cpu);
+    }
+  }
+
+  // Call once the server is shut down: workers drain their streams before
+  // the completion queues may be shut down
+  void Stop() {
+    for (auto &t : workers_) {
+      t.join();
+    }
+    for (auto &cq : cqs_) {
+      cq->Shutdown();
+    }
+    for (auto &t : pollers_) {
+      t.join();
+    }
+  }
+
+  // Completion queue events delivered and, for busy pollers, polls that
+  // found none
+  void PrintPollStats(std::ostream &os) const {
+    os << "poll events=" << events_.load(std::memory_order_relaxed)
+       << " empty=" << empty_polls_.load(std::memory_order_relaxed) << "\n";
+    if (duplex_) {
+      os << "writes pongs=" << pongs_written_.load(std::memory_order_relaxed)
+         << " flushes=" << flushes_.load(std::memory_order_relaxed) << "\n";
+    }
+  }
+
+private:
+  static void LogPlacement(const char *role, size_t index, int cpu) {
+    if (cpu >= 0) {
+      std::cout << role << " " << index << " pinned to cpu " << cpu << "\n";
+    }
+  }
+
+  void Poll(ServerCompletionQueue *cq, int cpu) {
+    CpuAssigner::Pin(cpu);
+    void *tag;
+    bool ok;
+    uint64_t events = 0;
+    uint64_t empty = 0;
+    if (busy_poll_) {
+      // A zero deadline polls the transport once without blocking
+      const gpr_timespec now = gpr_time_0(GPR_CLOCK_MONOTONIC);
+      for (;;) {
+        const auto status = cq->AsyncNext(&tag, &ok, now);
+        if (status == CompletionQueue::GOT_EVENT) {
+          ++events;
+          static_cast<FiberTag *>(tag)->Complete(ok);
+        } else if (status == CompletionQueue::TIMEOUT) {
+          ++empty;
+          CpuRelax();
+        } else {
+          break;
+        }
+      }
+    } else {
+      while (cq->Next(&tag, &ok)) {
+        ++events;
+        static_cast<FiberTag *>(tag)->Complete(ok);
+      }
+    }
+    events_.fetch_add(events, std::memory_order_relaxed);
+    empty_polls_.fetch_add(empty, std::memory_order_relaxed);
+  }
+
+  void Work(int id, ServerCompletionQueue *cq, int cpu) {
+    CpuAssigner::Pin(cpu);
+    if (steal_group_) {
+      boost::fibers::use_scheduling_algorithm<WorkStealingScheduler>(
+          *steal_group_, id);
+    } else {
+      boost::fibers::use_scheduling_algorithm<RPCScheduler>(idle_);
+    }
+    if (raw_) {
+      AcceptRaw(cq);
+    } else {
+      Accept(cq);
+    }
+  }
+
+  // The worker's main fiber keeps one stream request outstanding and hands
+  // every accepted stream to a fiber of its own.
+  void Accept(ServerCompletionQueue *cq) {
+    for (;;) {
+      auto stream = std::make_unique<Stream>();
+      service_.RequestStreamPingPong(&stream->ctx, &stream->rw, cq, cq,
+                                     &stream->tag);
+      if (!stream->tag.Wait()) {
+        break;
+      }
+      ConnectionStats::Global().Record(stream->ctx);
+      if (duplex_) {
+        boost::fibers::fiber(&AsyncPingPongServer::ServeDuplex, this,
+                             std::move(stream))
+            .detach();
+      } else {
+        boost::fibers::fiber(&AsyncPingPongServer::Serve,
+                             std::cref(service_time_), work_, arena_reset_,
+                             std::move(stream))
+            .detach();
+      }
+    }
+  }
+
+  static void Serve(const ServiceTime &service_time, const WorkKernel *work,
+                    int arena_reset, std::unique_ptr<Stream> stream) {
+    StreamMessages msgs(arena_reset);
+    StreamLatency latency;
+    for (;;) {
+      stream->rw.Read(msgs.ping(), &stream->tag);
+      if (!stream->tag.Wait()) {
+        break;
+      }
+      const uint64_t received = latency.Read();
+      SimulateWork(service_time);
+      msgs.Echo(received, work);
+      latency.Write();
+      stream->rw.Write(*msgs.pong(), &stream->tag);
+      if (!stream->tag.Wait()) {
+        break;
+      }
+      msgs.Recycle();
+    }
+    stream->rw.Finish(Status::OK, &stream->tag);
+    stream->tag.Wait();
+  }
+
+  // Reads and writes of one stream run in separate fibers so a pipelining
+  // client gets its next ping read while earlier pongs are still being
+  // written. Pongs come from a fixed pool that cycles between the two.
+  void ServeDuplex(std::unique_ptr<Stream> stream) {
+    using boost::fibers::channel_op_status;
+    const ServiceTime &service_time = service_time_;
+    StreamMessages msgs(arena_reset_);
+    // The pongs in flight live apart from msgs, whose arena may be rebuilt
+    // while the writer still holds them
+    google::protobuf::Arena arena;
+    boost::fibers::buffered_channel<Pong *> free(kDuplexDepth);
+    boost::fibers::buffered_channel<Pong *> ready(kDuplexDepth);
+    for (size_t i = 0; i + 1 < kDuplexDepth; ++i) {
+      free.push(google::protobuf::Arena::CreateMessage<Pong>(&arena));
+    }
+
+    boost::fibers::fiber writer([this, &stream, &free, &ready]() {
+      WritePongs(stream.get(), free, ready);
+    });
+
+    StreamLatency latency;
+    for (;;) {
+      stream->rw.Read(msgs.ping(), &stream->tag);
+      if (!stream->tag.Wait()) {
+        break;
+      }
+      const uint64_t received = latency.Read();
+      SimulateWork(service_time);
+      Pong *pong;
+      if (free.pop(pong) != channel_op_status::success) {
+        break;
+      }
+      msgs.Echo(received, work_, pong);
+      latency.Write();
+      if (ready.push(pong) != channel_op_status::success) {
+        break;
+      }
+      msgs.Recycle();
+    }
+    ready.close();
+    writer.join();
+
+    stream->rw.Finish(Status::OK, &stream->tag);
+    stream->tag.Wait();
+  }
+
+  // Writer fiber of a duplex stream. A pong is written with the buffer hint,
+  // leaving it in gRPC's transport buffer, when the next one is already
+  // queued and the batch has room; the first pong without the hint flushes
+  // the batch in one write. With a flush delay the writer waits for more
+  // pongs until that long after the batch's first one.
+  void WritePongs(Stream *stream, boost::fibers::buffered_channel<Pong *> &free,
+                  boost::fibers::buffered_channel<Pong *> &ready) {
+    using boost::fibers::channel_op_status;
+    FiberTag write_tag;
+    uint64_t written = 0;
+    uint64_t flushes = 0;
+    int batched = 0;
+    // The flush delay bounds how long a batch's first pong is held back,
+    // not the wait for each pong after it
+    std::chrono::steady_clock::time_point deadline;
+    Pong *pong;
+    channel_op_status status = ready.pop(pong);
+    while (status == channel_op_status::success) {
+      Pong *next = nullptr;
+      if (max_batch_ > 1) {
+        if (batched == 0 && flush_delay_.count() > 0) {
+          deadline = std::chrono::steady_clock::now() + flush_delay_;
+        }
+        status = ready.try_pop(next);
+        if (status == channel_op_status::empty &&
+            flush_delay_.count() > 0 && batched + 1 < max_batch_) {
+          status = ready.pop_wait_until(next, deadline);
+        }
+      }
+      const bool more = next != nullptr && ++batched < max_batch_;
+      grpc::WriteOptions options;
+      if (more) {
+        options.set_buffer_hint();
+      } else {
+        batched = 0;
+        ++flushes;
+      }
+      stream->rw.Write(*pong, options, &write_tag);
+      const bool ok = write_tag.Wait();
+      free.push(pong);
+      ++written;
+      if (!ok) {
+        break;
+      }
+      if (next != nullptr) {
+        pong = next;
+        status = channel_op_status::success;
+      } else if (status != channel_op_status::closed) {
+        status = ready.pop(pong);
+      }
+    }
+    // Unblocks a reader waiting for a free pong
+    free.close();
+    pongs_written_.fetch_add(written, std::memory_order_relaxed);
+    flushes_.fetch_add(flushes, std::memory_order_relaxed);
+  }
+
+  void AcceptRaw(ServerCompletionQueue *cq) {
+    for (;;) {
+      auto stream = std::make_unique<RawStream>();
+      generic_service_.RequestCall(&stream->ctx, &stream->rw, cq, cq,
+                                   &stream->tag);
+      if (!stream->tag.Wait()) {
+        break;
+      }
+      ConnectionStats::Global().Record(stream->ctx);
+      boost::fibers::fiber(&AsyncPingPongServer::ServeRaw,
+                           std::cref(service_time_), work_, std::move(stream))
+          .detach();
+    }
+  }
+
+  // Echo loop on wire bytes: the reply reuses the request's payload slices
+  static void ServeRaw(const ServiceTime &service_time, const WorkKernel *work,
+                       std::unique_ptr<RawStream> stream) {
+    Status status = Status::OK;
+    if (stream->ctx.method() != raw::kStreamPingPongMethod) {
+      status = Status(grpc::StatusCode::UNIMPLEMENTED, stream->ctx.method());
+    }
+    grpc::ByteBuffer request;
+    std::vector<grpc::Slice> wire;
+    std::vector<grpc::Slice> reply;
+    raw::Ping ping;
+    std::string flat;
+    StreamLatency latency;
+    while (status.ok()) {
+      stream->rw.Read(&request, &stream->tag);
+      if (!stream->tag.Wait()) {
+        break;
+      }
+      const uint64_t received = latency.Read();
+      if (!request.Dump(&wire).ok() || !raw::ParsePing(wire, &ping)) {
+        status = Status(grpc::StatusCode::INVALID_ARGUMENT, "malformed Ping");
+        break;
+      }
+      SimulateWork(service_time);
+      const uint64_t work_result =
+          work != nullptr ? work->Run(raw::FlatPayload(ping, &flat)) : 0;
+      std::optional<uint32_t> checksum;
+      if (ping.checksum) {
+        checksum = IntegrityCounters::Check(*ping.checksum,
+                                            raw::PayloadChecksum(ping));
+      }
+      raw::BuildPong(ping, received, work_result, checksum, &reply);
+      latency.Write();
+      stream->rw.Write(grpc::ByteBuffer(reply.data(), reply.size()),
+                       &stream->tag);
+      if (!stream->tag.Wait()) {
+        break;
+      }
+    }
+    stream->rw.Finish(status, &stream->tag);
+    stream->tag.Wait();
+  }
+};
+
+// Shared memory engine: one pinned thread per segment runs the same echo as
+// the gRPC handlers over the segment's ring pair, serving one client session
+// after another.
+class ShmPingPongServer {
+  std::vector<std::unique_ptr<shm::Channel>> channels_;
+  std::vector<std::thread> threads_;
+  std::vector<std::string> paths_;
+  std::atomic<bool> stopping_{false};
+  const ServiceTime service_time_;
+  const WorkKernel *const work_;
+  const int arena_reset_;
+  const IdlePolicy idle_;
+  CpuAssigner &cpus_;
+
+public:
+  ShmPingPongServer(const ServiceTime &service_time, const WorkKernel *work,
+                    int arena_reset, const IdlePolicy &idle,
+                    CpuAssigner &cpus)
+      : service_time_(service_time), work_(work), arena_reset_(arena_reset),
+        idle_(idle), cpus_(cpus) {}
+
+  // Creates segments <path>.0 to <path>.N-1 with rings of capacity bytes
+  bool Start(int num_streams, const std::string &path, uint64_t capacity) {
+    for (int i = 0; i < num_streams; ++i) {
+      paths_.push_back(path + "." + std::to_string(i));
+      auto channel = shm::Channel::Create(paths_.back(), capacity);
+      if (!channel) {
+        std::cerr << "Failed to create " << paths_.back() << "\n";
+        return false;
+      }
+      channels_.push_back(std::move(channel));
+    }
+    for (int i = 0; i < num_streams; ++i) {
+      const int cpu = cpus_.Next();
+      if (cpu >= 0) {
+        std::cout << "shm stream " << i << " pinned to cpu " << cpu << "\n";
+      }
+      threads_.emplace_back(&ShmPingPongServer::Serve, this,
+                            channels_[i].get(), cpu);
+    }
+    return true;
+  }
+
+  void Stop() {
+    stopping_.store(true, std::memory_order_relaxed);
+    // Both rings, so a thread blocked writing to a client that stopped
+    // reading wakes up too
+    for (auto &channel : channels_) {
+      channel->Close();
+    }
+    for (auto &t : threads_) {
+      t.join();
+    }
+    for (const auto &path : paths_) {
+      unlink(path.c_str());
+    }
+  }
+
+private:
+  void Serve(shm::Channel *channel, int cpu) {
+    CpuAssigner::Pin(cpu);
+    shm::Ring requests = channel->requests();
+    shm::Ring replies = channel->replies();
+    std::string request;
+    std::string reply;
+    while (!stopping_.load(std::memory_order_relaxed)) {
+      StreamMessages msgs(arena_reset_);
+      StreamLatency latency;
+      while (requests.Read(&request, idle_)) {
+        const uint64_t received = latency.Read();
+        if (!msgs.Parse(request.data(), request.size())) {
+          break;
+        }
+        SimulateWork(service_time_);
+        msgs.Echo(received, work_);
+        latency.Write();
+
+        msgs.Serialize(&reply);
+        if (!replies.Write(reply.data(), reply.size(), idle_)) {
+          break;
+        }
+        msgs.Recycle();
+      }
+      // Fails the client's reads if the session ended on a bad ping, then
+      // waits out the client's own close before resetting
+      replies.Close();
+      requests.WaitClosed(idle_);
+      if (!stopping_.load(std::memory_order_relaxed)) {
+        channel->Reset();
+      }
+    }
+  }
+};
+
+// io_uring engine, for measuring what gRPC itself costs: the Ping/Pong wire
+// bytes go over plain unix sockets, each framed by a 4 byte little-endian
+// length. Every thread owns a ring and is pinned to its own core. Rings
+// accept from the shared listeners with multishot accepts, receive with
+// multishot recvs into a provided buffer ring and send replies from
+// registered buffers. Each connection is a fiber resumed by its thread's
+// completion loop.
+class UringPingPongServer {
+  static constexpr unsigned kRingEntries = 1024;
+  static constexpr unsigned kRecvBuffers = 256; // power of two
+  static constexpr unsigned kRecvBufferSize = 16 * 1024;
+  static constexpr unsigned kSendSlots = 64;
+  static constexpr size_t kSendSlotSize = 32 * 1024;
+  static constexpr size_t kFrameHeader = sizeof(uint32_t);
+  static constexpr uint32_t kMaxFrame = 64 * 1024 * 1024;
+
+  // Operation kinds, kept in the low bits of user_data
+  static constexpr uint64_t kAccept = 0;
+  static constexpr uint64_t kRecv = 1;
+  static constexpr uint64_t kSend = 2;
+  static constexpr uint64_t kStop = 3;
+  static constexpr uint64_t kCancel = 4;
+  static constexpr uint64_t kOpMask = 7;
+
+  struct Connection {
+    int fd{-1};
+    std::string inbox;
+    size_t consumed{0};
+    std::string outbox; // replies that do not fit a send slot
+    char *slot{nullptr};
+    bool eof{false};
+    bool recv_armed{false};
+    bool send_done{false};
+    int send_result{0};
+    boost::fibers::mutex mtx;
+    boost::fibers::condition_variable cv;
+  };
+
+  // One ring and the connections it serves, touched by its thread only
+  class Worker {
+    UringPingPongServer &server_;
+    uring::Ring ring_;
+    uring::BufferRing recv_buffers_;
+    char *send_region_{nullptr};
+    bool fixed_buffers_{false};
+    std::vector<char *> free_slots_;
+    std::vector<bool> accept_armed_;
+    std::vector<Connection *> connections_;
+    bool stop_armed_{false};
+    bool stopping_{false};
+
+  public:
+    explicit Worker(UringPingPongServer &server) : server_(server) {}
+
+    ~Worker() {
+      if (send_region_ != nullptr) {
+        munmap(send_region_, kSendSlots * kSendSlotSize);
+      }
+    }
+
+    bool Init() {
+      if (!ring_.Init(kRingEntries) ||
+          !recv_buffers_.Init(ring_, 0, kRecvBuffers, kRecvBufferSize)) {
+        return false;
+      }
+      void *mem = mmap(nullptr, kSendSlots * kSendSlotSize,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1, 0);
+      if (mem == MAP_FAILED) {
+        return false;
+      }
+      send_region_ = static_cast<char *>(mem);
+      for (unsigned i = 0; i < kSendSlots; ++i) {
+        free_slots_.push_back(send_region_ + i * kSendSlotSize);
+      }
+      // Without registered buffers every reply goes through a plain send
+      iovec region{send_region_, kSendSlots * kSendSlotSize};
+      fixed_buffers_ = ring_.Register(IORING_REGISTER_BUFFERS, &region, 1) == 0;
+      return true;
+    }
+
+    void Run() {
+      accept_armed_.assign(server_.listen_fds_.size(), false);
+      for (size_t i = 0; i < accept_armed_.size(); ++i) {
+        ArmAccept(i);
+      }
+      ArmStop();
+      while (stop_armed_ || !connections_.empty() ||
+             std::find(accept_armed_.begin(), accept_armed_.end(), true) !=
+                 accept_armed_.end()) {
+        ring_.Submit(!ring_.HasCompletions());
+        ring_.Reap([this](const io_uring_cqe &cqe) { Complete(cqe); });
+        // Runs the connection fibers the completions made ready; they all
+        // block on their next operation before this returns
+        boost::this_fiber::yield();
+      }
+    }
+
+  private:
+    io_uring_sqe *Sqe() {
+      io_uring_sqe *sqe = ring_.GetSqe();
+      if (sqe == nullptr) {
+        std::cerr << "io_uring submission queue overflow\n";
+        std::abort();
+      }
+      return sqe;
+    }
+
+    void ArmAccept(size_t index) {
+      io_uring_sqe *sqe = Sqe();
+      sqe->opcode = IORING_OP_ACCEPT;
+      sqe->fd = server_.listen_fds_[index];
+      sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+      sqe->accept_flags = SOCK_CLOEXEC;
+      sqe->user_data = (index << 3) | kAccept;
+      accept_armed_[index] = true;
+    }
+
+    void ArmStop() {
+      io_uring_sqe *sqe = Sqe();
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->fd = server_.stop_fd_;
+      sqe->poll32_events = POLLIN;
+      sqe->user_data = kStop;
+      stop_armed_ = true;
+    }
+
+    void ArmRecv(Connection *c) {
+      io_uring_sqe *sqe = Sqe();
+      sqe->opcode = IORING_OP_RECV;
+      sqe->fd = c->fd;
+      sqe->ioprio = IORING_RECV_MULTISHOT;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = recv_buffers_.group_id();
+      sqe->user_data = reinterpret_cast<uint64_t>(c) | kRecv;
+      c->recv_armed = true;
+    }
+
+    void Complete(const io_uring_cqe &cqe) {
+      const bool more = cqe.flags & IORING_CQE_F_MORE;
+      switch (cqe.user_data & kOpMask) {
+      case kAccept: {
+        const size_t index = cqe.user_data >> 3;
+        if (cqe.res >= 0) {
+          if (stopping_) {
+            close(cqe.res);
+          } else {
+            Open(cqe.res);
+          }
+        }
+        if (!more) {
+          accept_armed_[index] = false;
+          if (!stopping_ && cqe.res != -EBADF && cqe.res != -EINVAL) {
+            ArmAccept(index);
+          }
+        }
+        break;
+      }
+      case kRecv: {
+        auto *c = reinterpret_cast<Connection *>(cqe.user_data & ~kOpMask);
+        if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+          const unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+          c->inbox.append(recv_buffers_.Buffer(bid), cqe.res);
+          recv_buffers_.Recycle(bid);
+        } else if (cqe.res != -ENOBUFS) {
+          c->eof = true;
+        }
+        if (!more) {
+          c->recv_armed = false;
+          // Multishot ends when the provided buffers ran out
+          if (!c->eof) {
+            ArmRecv(c);
+          }
+        }
+        c->cv.notify_one();
+        break;
+      }
+      case kSend: {
+        auto *c = reinterpret_cast<Connection *>(cqe.user_data & ~kOpMask);
+        c->send_result = cqe.res;
+        c->send_done = true;
+        c->cv.notify_one();
+        break;
+      }
+      case kStop:
+        stop_armed_ = false;
+        stopping_ = true;
+        for (size_t i = 0; i < accept_armed_.size(); ++i) {
+          if (accept_armed_[i]) {
+            io_uring_sqe *sqe = Sqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = (i << 3) | kAccept;
+            sqe->user_data = kCancel;
+          }
+        }
+        // Receives complete with end of stream and the fibers wind down
+        for (Connection *c : connections_) {
+          shutdown(c->fd, SHUT_RDWR);
+        }
+        break;
+      default:
+        break;
+      }
+    }
+
+    void Open(int fd) {
+      auto *c = new Connection();
+      c->fd = fd;
+      if (!free_slots_.empty()) {
+        c->slot = free_slots_.back();
+        free_slots_.pop_back();
+      }
+      connections_.push_back(c);
+      ArmRecv(c);
+      boost::fibers::fiber(&Worker::Serve, this, c).detach();
+    }
+
+    void Close(Connection *c) {
+      close(c->fd);
+      if (c->slot != nullptr) {
+        free_slots_.push_back(c->slot);
+      }
+      std::erase(connections_, c);
+      delete c;
+    }
+
+    // Length of the next complete frame in the inbox, if any
+    static bool NextFrame(const Connection *c, uint32_t *size) {
+      const size_t available = c->inbox.size() - c->consumed;
+      if (available < kFrameHeader) {
+        return false;
+      }
+      std::memcpy(size, c->inbox.data() + c->consumed, kFrameHeader);
+      return *size > kMaxFrame || available - kFrameHeader >= *size;
+    }
+
+    void Serve(Connection *c) {
+      StreamMessages msgs(server_.arena_reset_);
+      StreamLatency latency;
+      std::unique_lock<boost::fibers::mutex> lk(c->mtx);
+      for (;;) {
+        uint32_t size = 0;
+        c->cv.wait(lk, [c, &size]() { return c->eof || NextFrame(c, &size); });
+        if (!NextFrame(c, &size) || size > kMaxFrame) {
+          break;
+        }
+        const uint64_t received = latency.Read();
+        const char *frame = c->inbox.data() + c->consumed + kFrameHeader;
+        if (!msgs.Parse(frame, size)) {
+          break;
+        }
+        c->consumed += kFrameHeader + size;
+        if (c->consumed == c->inbox.size()) {
+          c->inbox.clear();
+          c->consumed = 0;
+        }
+        // The ring's fibers keep no timers, so this blocks the whole ring,
+        // as the sync engine blocks its thread
+        SimulateWork(server_.service_time_);
+        msgs.Echo(received, server_.work_);
+        latency.Write();
+
+        if (!Send(c, msgs, lk)) {
+          break;
+        }
+        msgs.Recycle();
+      }
+      shutdown(c->fd, SHUT_RDWR);
+      c->cv.wait(lk, [c]() { return !c->recv_armed; });
+      lk.unlock();
+      Close(c);
+    }
+
+    bool Send(Connection *c, StreamMessages &msgs,
+              std::unique_lock<boost::fibers::mutex> &lk) {
+      const uint32_t size = msgs.pong()->ByteSizeLong();
+      const size_t total = kFrameHeader + size;
+      const bool fixed = c->slot != nullptr && total <= kSendSlotSize;
+      char *buf = c->slot;
+      if (!fixed) {
+        c->outbox.resize(total);
+        buf = c->outbox.data();
+      }
+      std::memcpy(buf, &size, kFrameHeader);
+      msgs.Serialize(reinterpret_cast<uint8_t *>(buf + kFrameHeader));
+      for (size_t sent = 0; sent < total;) {
+        io_uring_sqe *sqe = Sqe();
+        if (fixed && fixed_buffers_) {
+          sqe->opcode = IORING_OP_WRITE_FIXED;
+          sqe->buf_index = 0;
+        } else {
+          sqe->opcode = IORING_OP_SEND;
+          sqe->msg_flags = MSG_NOSIGNAL;
+        }
+        sqe->fd = c->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf + sent);
+        sqe->len = total - sent;
+        sqe->user_data = reinterpret_cast<uint64_t>(c) | kSend;
+        c->send_done = false;
+        c->cv.wait(lk, [c]() { return c->send_done; });
+        if (c->send_result <= 0) {
+          return false;
+        }
+        sent += c->send_result;
+      }
+      return true;
+    }
+  };
+
+  std::vector<int> listen_fds_;
+  std::vector<std::string> socket_files_;
+  int stop_fd_{-1};
+  std::vector<std::thread> threads_;
+  const ServiceTime service_time_;
+  const WorkKernel *const work_;
+  const int arena_reset_;
+  CpuAssigner &cpus_;
+
+  void Run(int cpu, std::latch *ready, std::atomic<bool> *failed) {
+    CpuAssigner::Pin(cpu);
+    Worker worker(*this);
+    const bool ok = worker.Init();
+    if (!ok) {
+      failed->store(true);
+    }
+    ready->count_down();
+    if (ok) {
+      worker.Run();
+    }
+  }
+
+public:
+  UringPingPongServer(const ServiceTime &service_time, const WorkKernel *work,
+                      int arena_reset, CpuAssigner &cpus)
+      : service_time_(service_time), work_(work), arena_reset_(arena_reset),
+        cpus_(cpus) {}
+
+  // Listens on the unix targets and starts one ring per thread
+  bool Start(int num_threads, const std::vector<ListenSpec> &listeners) {
+    // Replies to a closed peer must fail with EPIPE, not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+    for (const auto &spec : listeners) {
+      const int fd = ListenUnix(spec.target);
+      if (fd < 0) {
+        std::cerr << "Failed to listen on " << spec.target << "\n";
+        return false;
+      }
+      listen_fds_.push_back(fd);
+      if (spec.target.starts_with("unix:")) {
+        sockaddr_un addr;
+        socklen_t len;
+        UnixAddress(spec.target, &addr, &len);
+        socket_files_.push_back(addr.sun_path);
+      }
+    }
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    std::latch ready(num_threads);
+    std::atomic<bool> failed{false};
+    for (int i = 0; i < num_threads; ++i) {
+      const int cpu = cpus_.Next();
+      if (cpu >= 0) {
+        std::cout << "uring thread " << i << " pinned to cpu " << cpu << "\n";
+      }
+      threads_.emplace_back(&UringPingPongServer::Run, this, cpu, &ready,
+                            &failed);
+    }
+    ready.wait();
+    if (failed.load()) {
+      std::cerr << "io_uring setup failed: " << std::strerror(errno) << "\n";
+      Stop();
+      return false;
+    }
+    return true;
+  }
+
+  // Ends every connection and joins the rings
+  void Stop() {
+    if (stop_fd_ < 0) {
+      return;
+    }
+    eventfd_write(stop_fd_, 1);
+    for (auto &t : threads_) {
+      t.join();
+    }
+    threads_.clear();
+    for (int fd : listen_fds_) {
+      close(fd);
+    }
+    for (const auto &path : socket_files_) {
+      unlink(path.c_str());
+    }
+    close(stop_fd_);
+    stop_fd_ = -1;
+  }
+};
+
+// One independent gRPC server with its own completion queues, threads and
+// socket; shards share nothing but the process-wide statistics
+struct ServerShard {
+  PingPongService service;
+  AsyncPingPongServer async_server;
+  std::vector<std::unique_ptr<TunedListener>> tuned_listeners;
+  std::unique_ptr<Server> server;
+
+  ServerShard(const ServerConfig &config, CpuAssigner &cpus)
+      : service(config.use_fibers, config.service_time, config.work.get(),
+                config.arena_reset, config.idle, cpus),
+        async_server(config.codec == "raw", config.duplex, config.max_batch,
+                     config.flush_us, config.poll == "busy",
+                     config.service_time, config.work.get(),
+                     config.arena_reset, config.idle, cpus) {}
+};
+
 int main(int argc, char *argv[]) {
   namespace po = boost::program_options;
   po::options_description desc("Allowed options");
-  desc.add_options()("fibers", po::value<bool>()->default_value(false),
-                     "Use fibers")("sleep",
-                                   po::value<bool>()->default_value(false),
-                                   "Sleep 4microsecs before reply")(
+  const std::string work_help =
+      "CPU-bound kernel run on each payload, its digest returned in the "
+      "pong: KIND[:ROUNDS] with KIND one of " +
+      work::Names();
+  desc.add_options()(
+      "mode", po::value<std::string>()->default_value("sync"),
+      "Server engine: sync, async or uring (length-prefixed frames over "
+      "io_uring, no gRPC)")(
+      "scheduler", po::value<std::string>()->default_value("rpc"),
+      "Fiber scheduler: rpc or work_stealing (async mode)")(
+      "codec", po::value<std::string>()->default_value("proto"),
+      "Message codec: proto or raw wire parsing (async mode)")(
+      "clock", po::value<std::string>()->default_value("system"),
+      "Clock of server timestamps and latency histograms: system or tsc")(
+      "fibers", po::value<bool>()->default_value(false), "Use fibers")(
+      "duplex", po::value<bool>()->default_value(false),
+      "Separate reader and writer fibers per stream (async mode)")(
+      "max-batch", po::value<int>()->default_value(1),
+      "Pongs a duplex writer coalesces per flush when more are queued, 1 "
+      "flushes each")(
+      "flush-us", po::value<int>()->default_value(0),
+      "Microseconds a duplex writer holds a partial batch back, from its "
+      "first pong, before flushing it")(
+      "sleep", po::value<bool>()->default_value(false),
+      "Sleep 4microsecs before reply, short for --service-time=fixed:4us")(
+      "service-time", po::value<std::string>()->default_value("none"),
+      "Simulated work per message: none, fixed:4us, exp:MEAN or "
+      "lognormal:MEAN,SIGMA")(
+      "work", po::value<std::string>()->default_value("none"),
+      work_help.c_str())(
       "threads", po::value<int>()->default_value(4),
       "Number of worker threads")(
+      "pollers", po::value<int>()->default_value(1),
+      "Number of completion queue poller threads (async mode)")(
+      "poll", po::value<std::string>()->default_value("block"),
+      "Completion queue polling: block or busy (async mode)")(
+      "shards", po::value<int>()->default_value(1),
+      "Independent server instances, each listening on <socket>.N")(
+      "idle-spin", po::value<int>()->default_value(1000),
+      "Spin iterations before an idle fiber thread parks, -1 never parks")(
+      "arena-reset", po::value<int>()->default_value(0),
+      "Messages between per-stream arena resets, 0 never resets")(
+      "stats-interval", po::value<int>()->default_value(10),
+      "Seconds between latency reports, 0 disables them")(
+      "stats-file", po::value<std::string>()->default_value(""),
+      "File SIGUSR1 appends the latency histograms to, stdout if empty")(
+      "cpus", po::value<std::string>()->default_value(""),
+      "Cores to pin server threads to, e.g. 0-3,8; empty leaves them free")(
+      "numa-node", po::value<int>()->default_value(-1),
+      "NUMA node to bind memory to and take cores from, -1 for none")(
       "socket", po::value<std::string>()->default_value("/tmp/pingpong.sock"),
-      "Socket path");
+      "Socket path, used when no --listen is given")(
+      "listen", po::value<std::vector<std::string>>()->composing(),
+      "Address to serve on, repeatable: unix:///path, unix-abstract:name or "
+      "host:port, with optional ,nodelay=0|1,sndbuf=N,rcvbuf=N for TCP")(
+      "shm-streams", po::value<int>()->default_value(0),
+      "Shared memory ring pairs served besides gRPC, 0 disables them")(
+      "shm-path", po::value<std::string>()->default_value("/dev/shm/pingpong"),
+      "Prefix of the shared memory segment files, suffixed with .N")(
+      "shm-capacity", po::value<uint64_t>()->default_value(1 << 20),
+      "Bytes per shared memory ring, a power of two")(
+      "http2-stream-window", po::value<int>()->default_value(-1),
+      "Initial HTTP/2 stream window in bytes, -1 for gRPC's default")(
+      "http2-bdp-probe", po::value<int>()->default_value(-1),
+      "BDP probing that resizes the windows: 0 off, 1 on, -1 default")(
+      "http2-max-frame", po::value<int>()->default_value(-1),
+      "Largest HTTP/2 frame accepted, 16384 to 16777215 bytes")(
+      "http2-write-buffer", po::value<int>()->default_value(-1),
+      "Bytes buffered per stream before the transport flushes")(
+      "max-concurrent-streams", po::value<int>()->default_value(-1),
+      "Streams a client connection may open at once")(
+      "keepalive-ms", po::value<int>()->default_value(-1),
+      "Interval between keepalive pings to clients")(
+      "keepalive-timeout-ms", po::value<int>()->default_value(-1),
+      "Time to wait for a keepalive ping ack before closing")(
+      "max-message-size", po::value<int>()->default_value(16 * 1024),
+      "Largest gRPC message accepted or sent, in bytes; clients split bigger "
+      "payloads into chunks");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
   po::notify(vm);
 
-  ServerConfig config{.use_fibers = vm["fibers"].as<bool>(),
-                      .sleep = vm["sleep"].as<bool>(),
+  ServerConfig config{.mode = vm["mode"].as<std::string>(),
+                      .scheduler = vm["scheduler"].as<std::string>(),
+                      .poll = vm["poll"].as<std::string>(),
+                      .codec = vm["codec"].as<std::string>(),
+                      .clock = vm["clock"].as<std::string>(),
+                      .use_fibers = vm["fibers"].as<bool>(),
+                      .duplex = vm["duplex"].as<bool>(),
+                      .max_batch = vm["max-batch"].as<int>(),
+                      .flush_us = vm["flush-us"].as<int>(),
+                      .service_time = {},
+                      .work = {},
                       .num_threads = vm["threads"].as<int>(),
-                      .socket_path = vm["socket"].as<std::string>()};
-
-  PingPongService service(config.use_fibers, config.sleep);
-  ServerBuilder builder;
-
-  // Resource quota applies to both modes
-  auto resource_quota = grpc::ResourceQuota("pingpong_quota");
-  resource_quota.SetMaxThreads(config.num_threads);
-  builder.SetResourceQuota(resource_quota);
-
-  const auto max_size = 16 * 1024;
-  builder.SetMaxMessageSize(max_size);
-  builder.SetMaxReceiveMessageSize(max_size);
-  builder.SetMaxSendMessageSize(max_size);
-
-  builder.AddListeningPort("unix://" + config.socket_path,
-                           grpc::InsecureServerCredentials());
-  builder.RegisterService(&service);
-
-  auto server = builder.BuildAndStart();
-  std::cout << "Server running in " << (config.use_fibers ? "fiber" : "thread")
-            << " mode with " << config.num_threads << " threads"
-            << " with sleep? " << config.sleep << "\n";
-  server->Wait();
+                      .num_pollers = vm["pollers"].as<int>(),
+                      .shards = vm["shards"].as<int>(),
+                      .arena_reset = vm["arena-reset"].as<int>(),
+                      .idle = {.spin = vm["idle-spin"].as<int>()},
+                      .stats_interval = vm["stats-interval"].as<int>(),
+                      .stats_file = vm["stats-file"].as<std::string>(),
+                      .cpus = {},
+                      .numa_node = vm["numa-node"].as<int>(),
+                      .listeners = {},
+                      .shm_streams = vm["shm-streams"].as<int>(),
+                      .shm_path = vm["shm-path"].as<std::string>(),
+                      .shm_capacity = vm["shm-capacity"].as<uint64_t>(),
+                      .http2 = {
+                          .stream_window = vm["http2-stream-window"].as<int>(),
+                          .bdp_probe = vm["http2-bdp-probe"].as<int>(),
+                          .max_frame_size = vm["http2-max-frame"].as<int>(),
+                          .max_concurrent_streams =
+                              vm["max-concurrent-streams"].as<int>(),
+                          .keepalive_ms = vm["keepalive-ms"].as<int>(),
+                          .keepalive_timeout_ms =
+                              vm["keepalive-timeout-ms"].as<int>(),
+                          .write_buffer_size =
+                              vm["http2-write-buffer"].as<int>(),
+                      },
+                      .max_message_size = vm["max-message-size"].as<int>()};
+  if (config.mode != "sync" && config.mode != "async" &&
+      config.mode != "uring") {
+    std::cerr << "Unknown mode: " << config.mode << "\n";
+    return 1;
+  }
+  const bool async = config.mode == "async";
+  const bool uring = config.mode == "uring";
+  if (config.scheduler != "rpc" && config.scheduler != "work_stealing") {
+    std::cerr << "Unknown scheduler: " << config.scheduler << "\n";
+    return 1;
+  }
+  if (config.scheduler == "work_stealing" && !async) {
+    std::cerr << "work_stealing scheduler requires --mode=async\n";
+    return 1;
+  }
+  if (config.poll != "block" && config.poll != "busy") {
+    std::cerr << "Unknown poll mode: " << config.poll << "\n";
+    return 1;
+  }
+  if (config.poll == "busy" && !async) {
+    std::cerr << "busy polling requires --mode=async\n";
+    return 1;
+  }
+  if (async && config.num_pollers < 1) {
+    std::cerr << "At least one poller is required\n";
+    return 1;
+  }
+  std::vector<std::string> listen = {"unix://" +
+                                     vm["socket"].as<std::string>()};
+  if (vm.count("listen")) {
+    listen = vm["listen"].as<std::vector<std::string>>();
+  }
+  for (const auto &value : listen) {
+    ListenSpec spec;
+    if (!ListenSpec::Parse(value, &spec)) {
+      std::cerr << "Invalid listen address: " << value << "\n";
+      return 1;
+    }
+    config.listeners.push_back(spec);
+  }
+  if (!config.http2.Valid()) {
+    std::cerr << "Invalid HTTP/2 settings\n";
+    return 1;
+  }
+  if (config.max_message_size < 1) {
+    std::cerr << "Invalid maximum message size\n";
+    return 1;
+  }
+  if (config.shm_streams < 0 || !std::has_single_bit(config.shm_capacity)) {
+    std::cerr << "Invalid shared memory configuration\n";
+    return 1;
+  }
+  if (config.shards < 1) {
+    std::cerr << "At least one shard is required\n";
+    return 1;
+  }
+  if (uring) {
+    for (const auto &spec : config.listeners) {
+      if (!spec.IsUnix()) {
+        std::cerr << "uring mode serves unix sockets only: " << spec.target
+                  << "\n";
+        return 1;
+      }
+    }
+    if (config.shards > 1) {
+      std::cerr << "uring mode runs one ring per thread, use --threads "
+                   "instead of --shards\n";
+      return 1;
+    }
+  }
+  if (config.codec != "proto" && config.codec != "raw") {
+    std::cerr << "Unknown codec: " << config.codec << "\n";
+    return 1;
+  }
+  if (config.codec == "raw" && !async) {
+    std::cerr << "raw codec requires --mode=async\n";
+    return 1;
+  }
+  if (config.duplex && (!async || config.codec == "raw")) {
+    std::cerr << "duplex streams require --mode=async with the proto codec\n";
+    return 1;
+  }
+  if (const auto &value = vm["service-time"].as<std::string>();
+      !ServiceTime::Parse(value, &config.service_time)) {
+    std::cerr << "Invalid service time: " << value << "\n";
+    return 1;
+  }
+  if (vm["sleep"].as<bool>() && !config.service_time.enabled()) {
+    config.service_time = ServiceTime::Fixed(std::chrono::microseconds(4));
+  }
+  std::unique_ptr<WorkKernel> work;
+  if (const auto &value = vm["work"].as<std::string>();
+      !work::Parse(value, &work)) {
+    std::cerr << "Invalid work kernel: " << value << "\n";
+    return 1;
+  }
+  config.work = std::move(work);
+  if (config.clock != "system" && config.clock != "tsc") {
+    std::cerr << "Unknown clock: " << config.clock << "\n";
+    return 1;
+  }
+  if (config.clock == "tsc") {
+    if (!ServerClock::UseTsc()) {
+      std::cerr << "tsc clock requires an invariant TSC\n";
+      return 1;
+    }
+    std::cout << "Clock: tsc at " << TscClock::GHz() << " GHz\n";
+  }
+  if (config.max_batch < 1 || config.flush_us < 0) {
+    std::cerr << "Invalid write batching\n";
+    return 1;
+  }
+  if ((config.max_batch > 1 || config.flush_us > 0) && !config.duplex) {
+    std::cerr << "write batching requires --duplex\n";
+    return 1;
+  }
+  if (const auto &list = vm["cpus"].as<std::string>();
+      !list.empty() && !ParseCpuList(list, &config.cpus)) {
+    std::cerr << "Invalid cpu list: " << list << "\n";
+    return 1;
+  }
+  if (config.numa_node >= 0) {
+    std::vector<int> node_cpus;
+    if (!NodeCpus(config.numa_node, &node_cpus)) {
+      std::cerr << "Unknown NUMA node: " << config.numa_node << "\n";
+      return 1;
+    }
+    if (config.cpus.empty()) {
+      config.cpus = node_cpus;
+    } else {
+      std::erase_if(config.cpus, [&node_cpus](int cpu) {
+        return std::find(node_cpus.begin(), node_cpus.end(), cpu) ==
+               node_cpus.end();
+      });
+      if (config.cpus.empty()) {
+        std::cerr << "No cpu of --cpus is on NUMA node " << config.numa_node
+                  << "\n";
+        return 1;
+      }
+    }
+    if (!BindMemoryToNode(config.numa_node)) {
+      std::cerr << "Binding memory to NUMA node " << config.numa_node
+                << " failed\n";
+      return 1;
+    }
+  }
+  // Threads started from here on, gRPC's own included, inherit the set; the
+  // ones we own are then narrowed down to a single core each
+  if (!config.cpus.empty() && !SetThreadCpus(config.cpus)) {
+    std::cerr << "Setting cpu affinity failed\n";
+    return 1;
+  }
+  CpuAssigner cpu_assigner(config.cpus);
+
+  // Signals are blocked in every thread and handled by a dedicated one: it
+  // prints latency reports, dumps the histograms on SIGUSR1 and shuts the
+  // server down on SIGINT/SIGTERM
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  auto build_shard = [&config, &cpu_assigner, async](int index) {
+    auto shard = std::make_unique<ServerShard>(config, cpu_assigner);
+    ServerBuilder builder;
+
+    // Resource quota applies to both modes
+    auto resource_quota =
+        grpc::ResourceQuota("pingpong_quota_" + std::to_string(index));
+    resource_quota.SetMaxThreads(config.num_threads);
+    builder.SetResourceQuota(resource_quota);
+
+    builder.SetMaxMessageSize(config.max_message_size);
+    builder.SetMaxReceiveMessageSize(config.max_message_size);
+    builder.SetMaxSendMessageSize(config.max_message_size);
+    config.http2.Apply(builder);
+
+    std::string targets;
+    for (const auto &spec : config.listeners) {
+      ListenSpec shard_spec = spec;
+      shard_spec.target = spec.ShardTarget(index, config.shards);
+      const std::string &target = shard_spec.target;
+      targets += " " + target;
+      if (spec.Tuned()) {
+        auto listener = std::make_unique<TunedListener>(shard_spec);
+        if (!listener->Listen()) {
+          std::cerr << "Failed to listen on " << target << "\n";
+          std::exit(1);
+        }
+        shard->tuned_listeners.push_back(std::move(listener));
+      } else {
+        builder.AddListeningPort(target, grpc::InsecureServerCredentials());
+      }
+    }
+    if (async) {
+      shard->async_server.Register(builder, config.num_pollers);
+    } else {
+      builder.RegisterService(&shard->service);
+    }
+    shard->server = builder.BuildAndStart();
+    if (!shard->server) {
+      std::cerr << "Failed to listen on" << targets << "\n";
+      std::exit(1);
+    }
+    for (auto &listener : shard->tuned_listeners) {
+      listener->Start(shard->server.get());
+    }
+    std::cout << "Shard " << index << " listening on" << targets << "\n";
+    return shard;
+  };
+
+  if (!config.cpus.empty()) {
+    std::cout << "Server threads restricted to cpus";
+    for (int cpu : config.cpus) {
+      std::cout << " " << cpu;
+    }
+    if (config.numa_node >= 0) {
+      std::cout << " with memory bound to NUMA node " << config.numa_node;
+    }
+    std::cout << "\n";
+  }
+
+  std::vector<std::unique_ptr<ServerShard>> shards;
+  UringPingPongServer uring_server(config.service_time, config.work.get(),
+                                   config.arena_reset, cpu_assigner);
+  if (uring) {
+    if (!uring_server.Start(config.num_threads, config.listeners)) {
+      return 1;
+    }
+  } else {
+    for (int i = 0; i < config.shards; ++i) {
+      shards.push_back(build_shard(i));
+    }
+  }
+  ShmPingPongServer shm_server(config.service_time, config.work.get(),
+                               config.arena_reset, config.idle, cpu_assigner);
+  if (config.shm_streams > 0 &&
+      !shm_server.Start(config.shm_streams, config.shm_path,
+                        config.shm_capacity)) {
+    return 1;
+  }
+  std::thread signal_thread([&signals, &shards, &config]() {
+    LatencyReport report;
+    // Wakes up for the stats interval and, in between, to recalibrate the
+    // clock
+    const std::chrono::seconds stats(config.stats_interval);
+    const std::chrono::seconds recalibrate = ServerClock::RecalibrateEvery();
+    const std::chrono::seconds period =
+        recalibrate.count() > 0 ? recalibrate : stats;
+    const timespec timeout{.tv_sec = period.count(), .tv_nsec = 0};
+    auto next_report = std::chrono::steady_clock::now() + stats;
+    for (;;) {
+      const int sig = period.count() > 0
+                          ? sigtimedwait(&signals, nullptr, &timeout)
+                          : sigwaitinfo(&signals, nullptr);
+      if (sig < 0) {
+        if (errno != EAGAIN) {
+          continue;
+        }
+        ServerClock::Recalibrate();
+        if (stats.count() > 0 &&
+            std::chrono::steady_clock::now() >= next_report) {
+          report.PrintInterval(std::cout);
+          next_report += stats;
+        }
+      } else if (sig == SIGUSR1) {
+        if (config.stats_file.empty()) {
+          report.PrintTotal(std::cout);
+        } else {
+          std::ofstream out(config.stats_file, std::ios::app);
+          report.PrintTotal(out);
+        }
+      } else {
+        break;
+      }
+    }
+    const auto deadline =
+        std::chrono::system_clock::now() + std::chrono::seconds(1);
+    for (auto &shard : shards) {
+      for (auto &listener : shard->tuned_listeners) {
+        listener->Stop();
+      }
+      shard->server->Shutdown(deadline);
+    }
+  });
+
+  if (async) {
+    for (auto &shard : shards) {
+      shard->async_server.Start(config.num_threads,
+                                config.scheduler == "work_stealing");
+    }
+    std::cout << "Server running in async mode with " << config.num_threads
+              << " fiber threads (" << config.scheduler << " scheduler, "
+              << config.codec << " codec" << (config.duplex ? ", duplex" : "");
+    if (config.max_batch > 1) {
+      std::cout << ", batches of " << config.max_batch << " flushed after "
+                << config.flush_us << "us";
+    }
+    std::cout << ") and " << config.num_pollers << " " << config.poll
+              << " pollers"
+              << " with service time " << config.service_time
+              << " and work " << work::Describe(config.work.get()) << "\n";
+  } else if (uring) {
+    std::cout << "Server running in uring mode with " << config.num_threads
+              << " rings on";
+    for (const auto &spec : config.listeners) {
+      std::cout << " " << spec.target;
+    }
+    std::cout << " with service time " << config.service_time
+              << " and work " << work::Describe(config.work.get()) << "\n";
+  } else {
+    std::cout << "Server running in "
+              << (config.use_fibers ? "fiber" : "thread") << " mode with "
+              << config.num_threads << " threads"
+              << " with service time " << config.service_time
+              << " and work " << work::Describe(config.work.get()) << "\n";
+  }
+  if (!uring) {
+    std::cout << config.http2
+              << " max_message_size=" << config.max_message_size << "\n";
+  }
+  if (config.shards > 1) {
+    std::cout << config.shards << " shards, thread counts are per shard\n";
+  }
+  if (config.shm_streams > 0) {
+    std::cout << "Serving " << config.shm_streams
+              << " shared memory streams on " << config.shm_path << ".N\n";
+  }
+  for (auto &shard : shards) {
+    shard->server->Wait();
+  }
+  signal_thread.join();
+  uring_server.Stop();
+  shm_server.Stop();
+  if (async) {
+    for (auto &shard : shards) {
+      shard->async_server.Stop();
+      shard->async_server.PrintPollStats(std::cout);
+    }
+  }
+  std::cout << IdleStats::Global() << "\n";
+  std::cout << HandlerStats::Global() << "\n";
+  IntegrityCounters::PrintTotal(std::cout);
+  std::cout << "\n";
+  if (!uring) {
+    std::cout << ConnectionStats::Global() << "\n";
+  }
+  LatencyReport().PrintTotal(std::cout);
 
   return 0;
 }
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <random>
+#include <string>
+
+// Simulated backend work per message, from a --service-time value:
+// fixed:D, exp:MEAN or lognormal:MEAN,SIGMA, where durations take an ns, us,
+// ms or s suffix (e.g. fixed:4us, exp:50us, lognormal:50us,1.0) and SIGMA is
+// the standard deviation of the underlying normal. "none" disables it.
+class ServiceTime {
+public:
+  enum class Kind { kNone, kFixed, kExponential, kLognormal };
+
+private:
+  Kind kind_{Kind::kNone};
+  double mean_{0}; // nanoseconds
+  double sigma_{0};
+
+  static bool ParseDuration(const std::string &value, double *nanos) {
+    size_t end = 0;
+    double number;
+    try {
+      number = std::stod(value, &end);
+    } catch (const std::exception &) {
+      return false;
+    }
+    const std::string unit = value.substr(end);
+    if (unit == "ns") {
+      *nanos = number;
+    } else if (unit == "us") {
+      *nanos = number * 1e3;
+    } else if (unit == "ms") {
+      *nanos = number * 1e6;
+    } else if (unit == "s") {
+      *nanos = number * 1e9;
+    } else {
+      return false;
+    }
+    return *nanos >= 0;
+  }
+
+  static std::mt19937_64 &Engine() {
+    thread_local std::mt19937_64 engine{std::random_device{}()};
+    return engine;
+  }
+
+public:
+  static bool Parse(const std::string &value, ServiceTime *time) {
+    *time = ServiceTime();
+    if (value == "none") {
+      return true;
+    }
+    const size_t colon = value.find(':');
+    if (colon == std::string::npos) {
+      return false;
+    }
+    const std::string kind = value.substr(0, colon);
+    std::string args = value.substr(colon + 1);
+    if (kind == "fixed") {
+      time->kind_ = Kind::kFixed;
+    } else if (kind == "exp") {
+      time->kind_ = Kind::kExponential;
+    } else if (kind == "lognormal") {
+      time->kind_ = Kind::kLognormal;
+      const size_t comma = args.find(',');
+      if (comma == std::string::npos) {
+        return false;
+      }
+      try {
+        size_t end = 0;
+        time->sigma_ = std::stod(args.substr(comma + 1), &end);
+        if (end != args.size() - comma - 1 || time->sigma_ < 0) {
+          return false;
+        }
+      } catch (const std::exception &) {
+        return false;
+      }
+      args.resize(comma);
+    } else {
+      return false;
+    }
+    return ParseDuration(args, &time->mean_) &&
+           (time->kind_ == Kind::kFixed || time->mean_ > 0);
+  }
+
+  static ServiceTime Fixed(std::chrono::nanoseconds duration) {
+    ServiceTime time;
+    time.kind_ = Kind::kFixed;
+    time.mean_ = duration.count();
+    return time;
+  }
+
+  bool enabled() const noexcept { return kind_ != Kind::kNone; }
+
+  // Draws the work time of one message
+  std::chrono::nanoseconds Sample() const {
+    double nanos = mean_;
+    switch (kind_) {
+    case Kind::kNone:
+      return std::chrono::nanoseconds(0);
+    case Kind::kFixed:
+      break;
+    case Kind::kExponential:
+      nanos = std::exponential_distribution<double>(1 / mean_)(Engine());
+      break;
+    case Kind::kLognormal:
+      // Mean of the log-normal is exp(mu + sigma^2 / 2)
+      nanos = std::lognormal_distribution<double>(
+          std::log(mean_) - sigma_ * sigma_ / 2, sigma_)(Engine());
+      break;
+    }
+    return std::chrono::nanoseconds(static_cast<int64_t>(nanos));
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const ServiceTime &t) {
+    switch (t.kind_) {
+    case Kind::kNone:
+      return os << "none";
+    case Kind::kFixed:
+      return os << "fixed " << t.mean_ / 1e3 << "us";
+    case Kind::kExponential:
+      return os << "exponential, mean " << t.mean_ / 1e3 << "us";
+    case Kind::kLognormal:
+      return os << "lognormal, mean " << t.mean_ / 1e3
+                << "us sigma " << t.sigma_;
+    }
+    return os;
+  }
+};
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <memory>
+#include <new>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "idle.h"
+
+// Same-host transport that bypasses gRPC: a shared memory segment holds a
+// pair of single-producer single-consumer rings, requests from the client
+// and replies from the server, carrying length-prefixed Ping/Pong wire
+// bytes. Waiters spin per IdlePolicy before sleeping on a process-shared
+// futex.
+namespace shm {
+
+// Wakeup word for the single waiter of one ring direction. The waiter
+// advertises itself before its last check of the condition and the notifier
+// checks for it after publishing, so one of the two always sees the other.
+class Signal {
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<uint32_t> waiting_{0};
+
+public:
+  template <typename Ready>
+  void Wait(Ready &&ready, const IdlePolicy &policy) noexcept {
+    for (int i = 0; policy.spin < 0 || i < policy.spin; ++i) {
+      if (ready()) {
+        IdleStats::Global().spins.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      CpuRelax();
+    }
+    IdleStats::Global().parks.fetch_add(1, std::memory_order_relaxed);
+    for (;;) {
+      const uint32_t seq = seq_.load(std::memory_order_acquire);
+      waiting_.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready()) {
+        waiting_.store(0, std::memory_order_relaxed);
+        return;
+      }
+      // Not FUTEX_PRIVATE: the word is shared between processes
+      syscall(SYS_futex, &seq_, FUTEX_WAIT, seq, nullptr, nullptr, 0);
+    }
+  }
+
+  void Notify() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed) != 0) {
+      IdleStats::Global().wakeups.fetch_add(1, std::memory_order_relaxed);
+      seq_.fetch_add(1, std::memory_order_release);
+      syscall(SYS_futex, &seq_, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+  }
+};
+
+// Shared state of one ring; the bytes follow elsewhere in the segment
+struct RingHeader {
+  alignas(64) std::atomic<uint64_t> head{0}; // bytes published by producer
+  alignas(64) std::atomic<uint64_t> tail{0}; // bytes released by consumer
+  alignas(64) Signal readable;
+  Signal writable;
+  std::atomic<uint32_t> closed{0};
+};
+
+// Frames are a 4 byte length and the message, padded to 8 bytes
+class Ring {
+  RingHeader *header_;
+  uint8_t *data_;
+  uint64_t capacity_; // power of two
+
+  static uint64_t FrameSize(uint32_t size) noexcept {
+    return (sizeof(uint32_t) + size + 7) & ~uint64_t{7};
+  }
+
+  void CopyIn(uint64_t pos, const void *src, size_t n) noexcept {
+    const size_t offset = pos & (capacity_ - 1);
+    const size_t first = std::min<size_t>(n, capacity_ - offset);
+    std::memcpy(data_ + offset, src, first);
+    std::memcpy(data_, static_cast<const uint8_t *>(src) + first, n - first);
+  }
+
+  void CopyOut(uint64_t pos, void *dst, size_t n) const noexcept {
+    const size_t offset = pos & (capacity_ - 1);
+    const size_t first = std::min<size_t>(n, capacity_ - offset);
+    std::memcpy(dst, data_ + offset, first);
+    std::memcpy(static_cast<uint8_t *>(dst) + first, data_, n - first);
+  }
+
+public:
+  Ring(RingHeader *header, uint8_t *data, uint64_t capacity)
+      : header_(header), data_(data), capacity_(capacity) {}
+
+  // Producer side. Blocks while the ring is full; false once closed or if
+  // the message can never fit.
+  bool Write(const void *message, uint32_t size, const IdlePolicy &policy) {
+    const uint64_t frame = FrameSize(size);
+    if (frame > capacity_) {
+      return false;
+    }
+    const uint64_t head = header_->head.load(std::memory_order_relaxed);
+    auto fits = [this, head, frame]() {
+      return capacity_ - (head - header_->tail.load(
+                                     std::memory_order_acquire)) >=
+                 frame ||
+             Closed();
+    };
+    header_->writable.Wait(fits, policy);
+    if (Closed()) {
+      return false;
+    }
+    CopyIn(head, &size, sizeof(size));
+    CopyIn(head + sizeof(size), message, size);
+    header_->head.store(head + frame, std::memory_order_release);
+    header_->readable.Notify();
+    return true;
+  }
+
+  // Consumer side. Blocks until a message arrives; false once the ring is
+  // closed and drained.
+  bool Read(std::string *message, const IdlePolicy &policy) {
+    const uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    auto available = [this, tail]() {
+      return header_->head.load(std::memory_order_acquire) != tail ||
+             Closed();
+    };
+    header_->readable.Wait(available, policy);
+    if (header_->head.load(std::memory_order_acquire) == tail) {
+      return false;
+    }
+    uint32_t size;
+    CopyOut(tail, &size, sizeof(size));
+    message->resize(size);
+    CopyOut(tail + sizeof(size), message->data(), size);
+    header_->tail.store(tail + FrameSize(size), std::memory_order_release);
+    header_->writable.Notify();
+    return true;
+  }
+
+  bool Closed() const noexcept {
+    return header_->closed.load(std::memory_order_acquire) != 0;
+  }
+
+  // Consumer side: blocks until the ring is closed, reading nothing
+  void WaitClosed(const IdlePolicy &policy) noexcept {
+    header_->readable.Wait([this]() { return Closed(); }, policy);
+  }
+
+  // Either side, or a third party: wakes both ends and fails further
+  // writes; reads drain what is left
+  void Close() noexcept {
+    header_->closed.store(1, std::memory_order_release);
+    header_->readable.Notify();
+    header_->writable.Notify();
+  }
+};
+
+struct SegmentHeader {
+  static constexpr uint64_t kMagic = 0x70696e67706f6e67; // "pingpong"
+
+  uint64_t magic;
+  uint64_t capacity;
+  // Pid of the client whose session is in progress, 0 when free
+  std::atomic<uint32_t> attached{0};
+  RingHeader requests;
+  RingHeader replies;
+};
+
+// Mapping of one segment file: the header, then request and reply bytes
+class Channel {
+  SegmentHeader *header_;
+  size_t size_;
+
+  Channel(SegmentHeader *header, size_t size) : header_(header), size_(size) {}
+
+  uint8_t *Data(int index) const noexcept {
+    return reinterpret_cast<uint8_t *>(header_) + sizeof(SegmentHeader) +
+           index * header_->capacity;
+  }
+
+  // Polls of a takeover for the server to reset the segment, 1ms apart
+  static constexpr int kTakeoverPolls = 1000;
+
+  static bool Exited(uint32_t pid) noexcept {
+    return kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH;
+  }
+
+  static void *Map(int fd, size_t size) {
+    void *addr =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return addr == MAP_FAILED ? nullptr : addr;
+  }
+
+public:
+  ~Channel() { munmap(header_, size_); }
+
+  // Server side: (re)creates the segment file with rings of capacity bytes,
+  // a power of two
+  static std::unique_ptr<Channel> Create(const std::string &path,
+                                         uint64_t capacity) {
+    unlink(path.c_str());
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+      return nullptr;
+    }
+    const size_t size = sizeof(SegmentHeader) + 2 * capacity;
+    if (ftruncate(fd, size) != 0) {
+      close(fd);
+      return nullptr;
+    }
+    void *addr = Map(fd, size);
+    if (addr == nullptr) {
+      return nullptr;
+    }
+    auto *header = new (addr) SegmentHeader{};
+    header->magic = SegmentHeader::kMagic;
+    header->capacity = capacity;
+    return std::unique_ptr<Channel>(new Channel(header, size));
+  }
+
+  // Client side: maps an existing segment and claims it for one session;
+  // null if it does not exist or another live client holds it. Clients and
+  // server must share a pid namespace.
+  static std::unique_ptr<Channel> Attach(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+      return nullptr;
+    }
+    SegmentHeader probe;
+    if (pread(fd, &probe, sizeof(probe), 0) != sizeof(probe) ||
+        probe.magic != SegmentHeader::kMagic) {
+      close(fd);
+      return nullptr;
+    }
+    const size_t size = sizeof(SegmentHeader) + 2 * probe.capacity;
+    void *addr = Map(fd, size);
+    if (addr == nullptr) {
+      return nullptr;
+    }
+    std::unique_ptr<Channel> channel(
+        new Channel(static_cast<SegmentHeader *>(addr), size));
+    std::atomic<uint32_t> &attached = channel->header_->attached;
+    const uint32_t self = getpid();
+    uint32_t owner = 0;
+    if (attached.compare_exchange_strong(owner, self)) {
+      return channel;
+    }
+    // A client that died mid-session leaves its pid behind. Whoever swaps it
+    // for their own takes the segment over: closing the session, unless the
+    // dead client got that far, makes the server reset the segment, which
+    // frees it for the claim below.
+    if (!Exited(owner) || !attached.compare_exchange_strong(owner, self)) {
+      return nullptr;
+    }
+    if (!channel->requests().Closed()) {
+      channel->Close();
+    }
+    for (int i = 0; i < kTakeoverPolls; ++i) {
+      owner = 0;
+      if (attached.compare_exchange_strong(owner, self)) {
+        return channel;
+      }
+      if (owner != self) {
+        return nullptr; // another client claimed it after the reset
+      }
+      usleep(1000);
+    }
+    return nullptr;
+  }
+
+  Ring requests() const {
+    return Ring(&header_->requests, Data(0), header_->capacity);
+  }
+
+  Ring replies() const {
+    return Ring(&header_->replies, Data(1), header_->capacity);
+  }
+
+  // Either side: ends the session. Requests close last, so once the server
+  // sees them closed the client stores nothing more to the rings.
+  void Close() noexcept {
+    replies().Close();
+    requests().Close();
+  }
+
+  // Server side, once the client closed its requests: empties both rings
+  // and lets the next client attach
+  void Reset() noexcept {
+    for (RingHeader *ring : {&header_->requests, &header_->replies}) {
+      ring->head.store(0, std::memory_order_relaxed);
+      ring->tail.store(0, std::memory_order_relaxed);
+      ring->closed.store(0, std::memory_order_relaxed);
+    }
+    header_->attached.store(0, std::memory_order_release);
+  }
+};
+
+} // namespace shm
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <google/protobuf/arena.h>
+#include <ostream>
+#include <string>
+
+#include "alloc_counter.h"
+#include "crc32c.h"
+#include "per_thread.h"
+#include "pingpong.pb.h"
+#include "work_kernel.h"
+
+// Payload checksums of the pings that carry one, counted per thread
+struct IntegrityCounters {
+  std::atomic<uint64_t> checked{0};
+  std::atomic<uint64_t> mismatches{0};
+
+  // Counts a payload whose CRC32C is actual against the one its ping
+  // carried; returns actual, for the pong
+  static uint32_t Check(uint32_t carried, uint32_t actual) {
+    auto &c = PerThread<IntegrityCounters>::Local();
+    // Only the owning thread writes, so no locked increments
+    c.checked.store(c.checked.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    if (carried != actual) {
+      c.mismatches.store(c.mismatches.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    }
+    return actual;
+  }
+
+  static void PrintTotal(std::ostream &os) {
+    uint64_t checked = 0;
+    uint64_t mismatches = 0;
+    PerThread<IntegrityCounters>::ForEach(
+        [&](const IntegrityCounters &c) {
+          checked += c.checked.load(std::memory_order_relaxed);
+          mismatches += c.mismatches.load(std::memory_order_relaxed);
+        });
+    os << "integrity checked=" << checked << " mismatches=" << mismatches;
+  }
+};
+
+// Echo a ping back, stamping it with the server receive time and the work
+// kernel's digest of the payload, if there is a kernel. A ping's checksum is
+// verified and the pong gets the payload's own. The payload buffer is
+// swapped over rather than copied, leaving ping's payload with whatever pong
+// held before.
+inline void FillPong(pingpong::Ping *ping, pingpong::Pong *pong,
+                     uint64_t received, const WorkKernel *work) {
+  pong->set_sequence(ping->sequence());
+  pong->set_timestamp(ping->timestamp());
+  pong->set_server_timestamp(received);
+  pong->mutable_payload()->swap(*ping->mutable_payload());
+  pong->set_more(ping->more());
+  if (work != nullptr) {
+    pong->set_work_result(work->Run(pong->payload()));
+  }
+  if (ping->has_checksum()) {
+    const std::string &payload = pong->payload();
+    pong->set_checksum(IntegrityCounters::Check(
+        ping->checksum(), crc32c::Value(payload.data(), payload.size())));
+  } else {
+    pong->clear_checksum();
+  }
+}
+
+// Ping/Pong pair of one stream, allocated on a per-stream arena and reused
+// for every message. Payload buffers keep their capacity as they are swapped
+// back and forth, so the steady-state echo does not allocate. The arena is
+// rebuilt every reset_every messages (never if 0) so a stream that saw one
+// huge payload does not hold on to it. Allocations made while parsing,
+// echoing and serializing through it count as the handler's.
+class StreamMessages {
+  google::protobuf::Arena arena_;
+  pingpong::Ping *ping_;
+  pingpong::Pong *pong_;
+  const int reset_every_;
+  int since_reset_{0};
+  uint64_t messages_{0};
+  uint64_t allocations_{0};
+
+  void Allocate() {
+    ping_ = google::protobuf::Arena::CreateMessage<pingpong::Ping>(&arena_);
+    pong_ = google::protobuf::Arena::CreateMessage<pingpong::Pong>(&arena_);
+  }
+
+public:
+  explicit StreamMessages(int reset_every) : reset_every_(reset_every) {
+    Allocate();
+  }
+
+  ~StreamMessages() {
+    auto &stats = HandlerStats::Global();
+    stats.messages.fetch_add(messages_, std::memory_order_relaxed);
+    stats.allocations.fetch_add(allocations_, std::memory_order_relaxed);
+  }
+
+  pingpong::Ping *ping() { return ping_; }
+  pingpong::Pong *pong() { return pong_; }
+
+  // For the engines that carry the wire bytes themselves; gRPC parses into
+  // ping and serializes pong on its own
+  bool Parse(const void *data, size_t size) {
+    AllocationScope scope(&allocations_);
+    return ping_->ParseFromArray(data, static_cast<int>(size));
+  }
+
+  void Serialize(std::string *out) {
+    AllocationScope scope(&allocations_);
+    pong_->SerializeToString(out);
+  }
+
+  // Serializes into size bytes at out, size being pong's ByteSizeLong
+  void Serialize(uint8_t *out) {
+    AllocationScope scope(&allocations_);
+    pong_->SerializeWithCachedSizesToArray(out);
+  }
+
+  void Echo(uint64_t received, const WorkKernel *work) {
+    Echo(received, work, pong_);
+  }
+
+  // Echoes into a pong of the caller's, for streams that keep several in
+  // flight. Payload buffers then circulate between ping and those pongs, so
+  // each arena reset drops one of them.
+  void Echo(uint64_t received, const WorkKernel *work, pingpong::Pong *pong) {
+    AllocationScope scope(&allocations_);
+    FillPong(ping_, pong, received, work);
+    ++messages_;
+  }
+
+  // Call once pong has been written, or handed over, before the next read
+  void Recycle() {
+    if (reset_every_ > 0 && ++since_reset_ == reset_every_) {
+      AllocationScope scope(&allocations_);
+      arena_.Reset();
+      Allocate();
+      since_reset_ = 0;
+    }
+  }
+};
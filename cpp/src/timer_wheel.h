@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/fiber/context.hpp>
+#include <chrono>
+#include <cstdint>
+
+// Hierarchical timer wheel: four levels of 256 slots over ticks of 1024ns,
+// covering about 73 minutes. Adding a timer and expiring it are O(1); a
+// timer far out is moved down a level at most three times on the way. Timers
+// are intrusive nodes owned by the caller, so the wheel never allocates. Not
+// thread safe.
+class TimerWheel {
+public:
+  struct Timer {
+    Timer *next{nullptr};
+    uint64_t expiry{0}; // nanoseconds
+    void *data{nullptr};
+  };
+
+private:
+  static constexpr int kTickShift = 10;
+  static constexpr int kBits = 8;
+  static constexpr int kLevels = 4;
+  static constexpr uint64_t kSlots = 1 << kBits;
+
+  std::array<std::array<Timer *, kSlots>, kLevels> slots_{};
+  std::array<uint64_t, kLevels> counts_{};
+  uint64_t current_; // next tick to expire
+
+  static uint64_t Span(int level) noexcept {
+    return uint64_t{1} << (kBits * level);
+  }
+
+  void Place(Timer *timer) noexcept {
+    // Rounded up, so a timer never fires early
+    uint64_t tick = (timer->expiry + (1 << kTickShift) - 1) >> kTickShift;
+    tick = std::max(tick, current_);
+    int level = 0;
+    while (level + 1 < kLevels && tick - current_ >= Span(level + 1)) {
+      ++level;
+    }
+    // Beyond the top level the timer waits in its last slot and is placed
+    // again when that slot cascades
+    tick = std::min(tick, current_ + Span(kLevels) - 1);
+    Timer *&slot = slots_[level][(tick >> (kBits * level)) & (kSlots - 1)];
+    timer->next = slot;
+    slot = timer;
+    ++counts_[level];
+  }
+
+  // Moves the timers of the level's slot for the current tick one or more
+  // levels down; returns whether the level wrapped around too
+  bool Cascade(int level) noexcept {
+    const uint64_t index = (current_ >> (kBits * level)) & (kSlots - 1);
+    Timer *timer = slots_[level][index];
+    slots_[level][index] = nullptr;
+    while (timer != nullptr) {
+      Timer *next = timer->next;
+      --counts_[level];
+      Place(timer);
+      timer = next;
+    }
+    return index == 0;
+  }
+
+public:
+  explicit TimerWheel(uint64_t now) : current_(now >> kTickShift) {}
+
+  bool empty() const noexcept {
+    for (uint64_t count : counts_) {
+      if (count != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Add(Timer *timer) noexcept { Place(timer); }
+
+  // Hands every timer due by now to expire, in no particular order within
+  // a tick
+  template <typename F> void Advance(uint64_t now, F &&expire) {
+    const uint64_t target = now >> kTickShift;
+    while (current_ <= target) {
+      // Skips stretches with nothing to expire or cascade
+      int level = 0;
+      while (level < kLevels && counts_[level] == 0) {
+        ++level;
+      }
+      if (level == kLevels) {
+        current_ = target + 1;
+        return;
+      }
+      const uint64_t mask = Span(level) - 1;
+      if (level > 0 && (current_ & mask) != 0) {
+        current_ = std::min(target + 1, (current_ | mask) + 1);
+        continue;
+      }
+      const uint64_t index = current_ & (kSlots - 1);
+      if (index == 0) {
+        for (int l = 1; l < kLevels && Cascade(l); ++l) {
+        }
+      }
+      Timer *timer = slots_[0][index];
+      slots_[0][index] = nullptr;
+      ++current_;
+      while (timer != nullptr) {
+        Timer *next = timer->next;
+        --counts_[0];
+        expire(timer);
+        timer = next;
+      }
+    }
+  }
+
+  // Lower bound of the next expiry in nanoseconds, UINT64_MAX when empty;
+  // waking up at it either expires timers or cascades them closer
+  uint64_t NextExpiry() const noexcept {
+    uint64_t next = UINT64_MAX;
+    for (int level = 1; level < kLevels; ++level) {
+      if (counts_[level] != 0) {
+        const uint64_t mask = Span(level) - 1;
+        next = (current_ + mask) & ~mask;
+        break;
+      }
+    }
+    if (counts_[0] != 0) {
+      for (uint64_t tick = current_; tick < next; ++tick) {
+        if (slots_[0][tick & (kSlots - 1)] != nullptr) {
+          next = tick;
+          break;
+        }
+      }
+    }
+    return next == UINT64_MAX ? next : next << kTickShift;
+  }
+};
+
+// Fiber delays of one thread, kept in a timer wheel that the thread's
+// scheduler advances. Unlike boost::this_fiber::sleep_for, which goes
+// through the scheduler's ordered sleep queue, a delay costs O(1) however
+// many fibers are delayed at once.
+class FiberTimers {
+  static inline thread_local FiberTimers *current_ = nullptr;
+
+  TimerWheel wheel_{Now()};
+
+  static uint64_t Now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+public:
+  // A scheduler's timers serve the fibers of the thread that constructs it
+  FiberTimers() { current_ = this; }
+
+  ~FiberTimers() {
+    if (current_ == this) {
+      current_ = nullptr;
+    }
+  }
+
+  FiberTimers(const FiberTimers &) = delete;
+  FiberTimers &operator=(const FiberTimers &) = delete;
+
+  // Suspends the calling fiber for duration; false, without waiting, when
+  // the thread's scheduler keeps no timers
+  static bool Delay(std::chrono::nanoseconds duration) {
+    FiberTimers *timers = current_;
+    if (timers == nullptr) {
+      return false;
+    }
+    boost::fibers::context *self = boost::fibers::context::active();
+    const uint64_t now = Now();
+    if (timers->wheel_.empty()) {
+      // Catches the idle wheel up, so the timer lands on the lowest level
+      timers->wheel_.Advance(now, [](TimerWheel::Timer *) {});
+    }
+    TimerWheel::Timer timer;
+    timer.expiry = now + duration.count();
+    timer.data = self;
+    timers->wheel_.Add(&timer);
+    self->suspend();
+    return true;
+  }
+
+  // Scheduler side, from pick_next: readies the fibers whose delay is over.
+  // pick_next also runs on the stack of a fiber that is just suspending,
+  // whose context is not saved yet; readying it there would let a peer
+  // thread resume it mid-switch, so its own timer goes back into the wheel
+  // and fires on the next call.
+  void Expire() noexcept {
+    if (wheel_.empty()) {
+      return;
+    }
+    boost::fibers::context *active = boost::fibers::context::active();
+    TimerWheel::Timer *own = nullptr;
+    wheel_.Advance(Now(), [active, &own](TimerWheel::Timer *timer) {
+      auto *ctx = static_cast<boost::fibers::context *>(timer->data);
+      if (ctx == active) {
+        own = timer;
+      } else {
+        active->schedule(ctx);
+      }
+    });
+    if (own != nullptr) {
+      wheel_.Add(own);
+    }
+  }
+
+  // Scheduler side, from suspend_until: the time to wake up at for the
+  // earlier of the scheduler's own deadline and the next delay
+  std::chrono::steady_clock::time_point
+  Deadline(std::chrono::steady_clock::time_point deadline) const noexcept {
+    const uint64_t next = wheel_.NextExpiry();
+    if (next == UINT64_MAX) {
+      return deadline;
+    }
+    return std::min(deadline, std::chrono::steady_clock::time_point(
+                                  std::chrono::nanoseconds(next)));
+  }
+};
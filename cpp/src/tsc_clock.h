@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+// Wall clock read from the time stamp counter: one rdtsc instead of a
+// clock_gettime call per reading. Calibration maps ticks to nanoseconds since
+// the epoch against CLOCK_REALTIME; Recalibrate re-anchors the mapping and
+// re-measures the rate, so called every so often it keeps readings
+// comparable with other processes' system clocks as NTP adjusts them.
+// Between calls they drift by at most the adjustment rate, about 500ppm.
+// Only invariant TSCs qualify, which tick at a constant rate on every core.
+class TscClock {
+  // The anchor is published under a sequence lock: odd while the single
+  // writer updates it, so readers retry rather than mix two anchors
+  static inline std::atomic<uint64_t> sequence_{0};
+  static inline std::atomic<uint64_t> base_ticks_{0};
+  static inline std::atomic<uint64_t> base_nanos_{0};
+  static inline std::atomic<uint64_t> nanos_per_tick_{0}; // 32.32 fixed point
+
+  // Slews beyond this rate are clock steps, which re-anchor without
+  // re-measuring the rate
+  static constexpr uint64_t kMaxSlewPpm = 1000;
+
+  static uint64_t Realtime() noexcept {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * uint64_t{1000000000} + ts.tv_nsec;
+  }
+
+  // Pairs a realtime reading with the tick count halfway through it, taking
+  // the tightest of a few tries to keep preemption out of the sample
+  static void Sample(uint64_t *ticks, uint64_t *nanos) noexcept {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 16; ++i) {
+      const uint64_t before = Ticks();
+      const uint64_t now = Realtime();
+      const uint64_t after = Ticks();
+      if (after - before < best) {
+        best = after - before;
+        *ticks = before + (after - before) / 2;
+        *nanos = now;
+      }
+    }
+  }
+
+  static void Publish(uint64_t ticks, uint64_t nanos, uint64_t rate) noexcept {
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    base_ticks_.store(ticks, std::memory_order_relaxed);
+    base_nanos_.store(nanos, std::memory_order_relaxed);
+    nanos_per_tick_.store(rate, std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+public:
+  static uint64_t Ticks() noexcept {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  static bool Invariant() noexcept {
+#if defined(__x86_64__)
+    unsigned eax, ebx, ecx, edx;
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) &&
+           (edx & (1u << 8)) != 0;
+#else
+    return false;
+#endif
+  }
+
+  // Measures the tick rate over about 20ms; false without an invariant TSC
+  static bool Calibrate() {
+    if (!Invariant()) {
+      return false;
+    }
+    uint64_t ticks0 = 0, nanos0 = 0, ticks1 = 0, nanos1 = 0;
+    Sample(&ticks0, &nanos0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Sample(&ticks1, &nanos1);
+    if (ticks1 <= ticks0 || nanos1 <= nanos0) {
+      return false;
+    }
+    Publish(ticks1, nanos1,
+            ((unsigned __int128)(nanos1 - nanos0) << 32) / (ticks1 - ticks0));
+    return true;
+  }
+
+  // Re-anchors at the current realtime and re-measures the rate over the
+  // span since the last anchor; from one thread at a time, after Calibrate
+  static void Recalibrate() noexcept {
+    uint64_t ticks = 0, nanos = 0;
+    Sample(&ticks, &nanos);
+    const uint64_t base_ticks = base_ticks_.load(std::memory_order_relaxed);
+    const uint64_t base_nanos = base_nanos_.load(std::memory_order_relaxed);
+    uint64_t rate = nanos_per_tick_.load(std::memory_order_relaxed);
+    if (ticks > base_ticks && nanos > base_nanos) {
+      const uint64_t measured =
+          ((unsigned __int128)(nanos - base_nanos) << 32) /
+          (ticks - base_ticks);
+      const uint64_t slew = measured > rate ? measured - rate : rate - measured;
+      if (slew <= rate / 1000000 * kMaxSlewPpm) {
+        rate = measured;
+      }
+    }
+    Publish(ticks, nanos, rate);
+  }
+
+  static double GHz() noexcept {
+    const uint64_t rate = nanos_per_tick_.load(std::memory_order_relaxed);
+    return rate == 0 ? 0 : 4294967296.0 / rate;
+  }
+
+  // Length of a span of ticks in nanoseconds
+  static uint64_t Nanos(uint64_t ticks) noexcept {
+    return ((unsigned __int128)ticks *
+            nanos_per_tick_.load(std::memory_order_relaxed)) >>
+           32;
+  }
+
+  // Nanoseconds since the epoch at a tick count; call Calibrate first
+  static uint64_t Wall(uint64_t ticks) noexcept {
+    uint64_t sequence, base_ticks, base_nanos, rate;
+    do {
+      sequence = sequence_.load(std::memory_order_acquire);
+      base_ticks = base_ticks_.load(std::memory_order_relaxed);
+      base_nanos = base_nanos_.load(std::memory_order_relaxed);
+      rate = nanos_per_tick_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) != 0 ||
+             sequence_.load(std::memory_order_relaxed) != sequence);
+    // A core whose counter trails the calibrating one by a few ticks, or a
+    // reading taken just before a re-anchor, reads the anchor instant rather
+    // than wrapping around
+    const int64_t since = ticks - base_ticks;
+    if (since <= 0) {
+      return base_nanos;
+    }
+    return base_nanos + static_cast<uint64_t>(
+                            ((unsigned __int128)since * rate) >> 32);
+  }
+
+  static uint64_t Now() noexcept { return Wall(Ticks()); }
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Minimal io_uring binding over the raw system calls, covering what the
+// uring engine needs: submission and completion rings, registered buffers
+// and provided buffer rings. One Ring belongs to one thread.
+namespace uring {
+
+class Ring {
+  int fd_{-1};
+  io_uring_params params_{};
+
+  void *sq_ptr_{nullptr};
+  size_t sq_size_{0};
+  void *cq_ptr_{nullptr};
+  size_t cq_size_{0};
+  io_uring_sqe *sqes_{nullptr};
+  size_t sqes_size_{0};
+
+  std::atomic<unsigned> *sq_head_{nullptr};
+  std::atomic<unsigned> *sq_tail_{nullptr};
+  unsigned sq_mask_{0};
+  unsigned *sq_array_{nullptr};
+  std::atomic<unsigned> *cq_head_{nullptr};
+  std::atomic<unsigned> *cq_tail_{nullptr};
+  unsigned cq_mask_{0};
+  io_uring_cqe *cqes_{nullptr};
+
+  unsigned sqe_tail_{0}; // local tail, published on Submit
+
+  template <typename T> static T *At(void *base, uint32_t offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+  }
+
+  int Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(SYS_io_uring_enter, fd_, to_submit, min_complete, flags,
+                   nullptr, 0);
+  }
+
+public:
+  Ring() = default;
+  Ring(const Ring &) = delete;
+  Ring &operator=(const Ring &) = delete;
+
+  ~Ring() {
+    if (sqes_ != nullptr) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+      munmap(cq_ptr_, cq_size_);
+    }
+    if (sq_ptr_ != nullptr) {
+      munmap(sq_ptr_, sq_size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  // Sets up a ring of entries submission slots; false with errno set
+  bool Init(unsigned entries) {
+    // Completions are only reaped when this thread enters the kernel anyway
+    params_.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    fd_ = syscall(SYS_io_uring_setup, entries, &params_);
+    if (fd_ < 0) {
+      params_ = {};
+      fd_ = syscall(SYS_io_uring_setup, entries, &params_);
+    }
+    if (fd_ < 0) {
+      return false;
+    }
+    sq_size_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    cq_size_ =
+        params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params_.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+      sq_ptr_ = nullptr;
+      return false;
+    }
+    cq_ptr_ = sq_ptr_;
+    if (!single_mmap) {
+      cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (cq_ptr_ == MAP_FAILED) {
+        cq_ptr_ = nullptr;
+        return false;
+      }
+    }
+    sqes_size_ = params_.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    sq_head_ = At<std::atomic<unsigned>>(sq_ptr_, params_.sq_off.head);
+    sq_tail_ = At<std::atomic<unsigned>>(sq_ptr_, params_.sq_off.tail);
+    sq_mask_ = *At<unsigned>(sq_ptr_, params_.sq_off.ring_mask);
+    sq_array_ = At<unsigned>(sq_ptr_, params_.sq_off.array);
+    cq_head_ = At<std::atomic<unsigned>>(cq_ptr_, params_.cq_off.head);
+    cq_tail_ = At<std::atomic<unsigned>>(cq_ptr_, params_.cq_off.tail);
+    cq_mask_ = *At<unsigned>(cq_ptr_, params_.cq_off.ring_mask);
+    cqes_ = At<io_uring_cqe>(cq_ptr_, params_.cq_off.cqes);
+    sqe_tail_ = sq_tail_->load(std::memory_order_relaxed);
+    return true;
+  }
+
+  int fd() const noexcept { return fd_; }
+
+  // Next free submission entry, zeroed; submits what is queued when the
+  // ring is full
+  io_uring_sqe *GetSqe() {
+    if (sqe_tail_ - sq_head_->load(std::memory_order_acquire) >=
+        params_.sq_entries) {
+      Submit(0);
+      if (sqe_tail_ - sq_head_->load(std::memory_order_acquire) >=
+          params_.sq_entries) {
+        return nullptr;
+      }
+    }
+    const unsigned index = sqe_tail_ & sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sqe_tail_;
+    return sqe;
+  }
+
+  // Publishes queued entries and, if wait is set, blocks until at least one
+  // completion is available
+  int Submit(bool wait) {
+    const unsigned to_submit =
+        sqe_tail_ - sq_tail_->load(std::memory_order_relaxed);
+    sq_tail_->store(sqe_tail_, std::memory_order_release);
+    if (to_submit == 0 && !wait) {
+      return 0;
+    }
+    int ret;
+    do {
+      ret = Enter(to_submit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+  }
+
+  bool HasCompletions() const noexcept {
+    return cq_head_->load(std::memory_order_relaxed) !=
+           cq_tail_->load(std::memory_order_acquire);
+  }
+
+  // Hands every available completion to f and releases it
+  template <typename F> unsigned Reap(F &&f) {
+    unsigned head = cq_head_->load(std::memory_order_relaxed);
+    const unsigned tail = cq_tail_->load(std::memory_order_acquire);
+    const unsigned count = tail - head;
+    for (; head != tail; ++head) {
+      f(cqes_[head & cq_mask_]);
+    }
+    cq_head_->store(head, std::memory_order_release);
+    return count;
+  }
+
+  int Register(unsigned opcode, void *arg, unsigned nr_args) {
+    return syscall(SYS_io_uring_register, fd_, opcode, arg, nr_args);
+  }
+};
+
+// Provided buffer ring: the kernel picks a buffer of group_id for each
+// buffer-select receive and the owner hands it back once consumed
+class BufferRing {
+  Ring *ring_{nullptr};
+  io_uring_buf_ring *buf_ring_{nullptr};
+  size_t ring_size_{0};
+  char *buffers_{nullptr};
+  size_t buffers_size_{0};
+  unsigned count_{0};
+  unsigned buffer_size_{0};
+  uint16_t group_id_{0};
+  uint16_t tail_{0};
+
+public:
+  BufferRing() = default;
+  BufferRing(const BufferRing &) = delete;
+  BufferRing &operator=(const BufferRing &) = delete;
+
+  ~BufferRing() {
+    if (ring_ != nullptr) {
+      io_uring_buf_reg reg{};
+      reg.bgid = group_id_;
+      ring_->Register(IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+    if (buf_ring_ != nullptr) {
+      munmap(buf_ring_, ring_size_);
+    }
+    if (buffers_ != nullptr) {
+      munmap(buffers_, buffers_size_);
+    }
+  }
+
+  // count must be a power of two
+  bool Init(Ring &ring, uint16_t group_id, unsigned count,
+            unsigned buffer_size) {
+    count_ = count;
+    buffer_size_ = buffer_size;
+    group_id_ = group_id;
+    ring_size_ = count * sizeof(io_uring_buf);
+    void *mem = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      return false;
+    }
+    buf_ring_ = static_cast<io_uring_buf_ring *>(mem);
+    buffers_size_ = size_t{count} * buffer_size;
+    mem = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      return false;
+    }
+    buffers_ = static_cast<char *>(mem);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = count;
+    reg.bgid = group_id;
+    if (ring.Register(IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+      return false;
+    }
+    ring_ = &ring;
+    for (unsigned bid = 0; bid < count; ++bid) {
+      Recycle(bid);
+    }
+    return true;
+  }
+
+  uint16_t group_id() const noexcept { return group_id_; }
+
+  const char *Buffer(unsigned bid) const noexcept {
+    return buffers_ + size_t{bid} * buffer_size_;
+  }
+
+  void Recycle(unsigned bid) noexcept {
+    // io_uring_buf_ring::bufs sits 8 bytes in when compiled as C++, where
+    // the empty struct of __DECLARE_FLEX_ARRAY takes space, so the ring is
+    // addressed as the plain array it is; the tail overlays bufs[0].resv
+    auto *bufs = reinterpret_cast<io_uring_buf *>(buf_ring_);
+    io_uring_buf &buf = bufs[tail_ & (count_ - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(Buffer(bid));
+    buf.len = buffer_size_;
+    buf.bid = static_cast<uint16_t>(bid);
+    ++tail_;
+    std::atomic_ref<uint16_t>(bufs[0].resv)
+        .store(tail_, std::memory_order_release);
+  }
+};
+
+} // namespace uring
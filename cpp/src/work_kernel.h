@@ -0,0 +1,352 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#if defined(__AES__)
+#include <wmmintrin.h>
+#endif
+
+#include "crc32c.h"
+
+// CPU-bound work a handler does per message, from a --work value:
+// KIND[:ROUNDS], where ROUNDS repeats the kernel to scale its cost. Each
+// round digests the echoed payload into 64 bits, seeded with the previous
+// round's digest; the last one goes into the Pong's work_result, so the work
+// cannot be optimized away and clients can check it. Kernels are stateless
+// and shared by all handler threads.
+class WorkKernel {
+  const char *name_;
+  int rounds_;
+
+protected:
+  virtual uint64_t Round(std::string_view payload, uint64_t seed) const = 0;
+
+  // Per-thread buffer for kernels that produce a transformed copy
+  static uint8_t *Scratch(size_t size) {
+    thread_local std::string scratch;
+    if (scratch.size() < size) {
+      scratch.resize(size);
+    }
+    return reinterpret_cast<uint8_t *>(scratch.data());
+  }
+
+public:
+  WorkKernel(const char *name, int rounds) : name_(name), rounds_(rounds) {}
+  virtual ~WorkKernel() = default;
+
+  uint64_t Run(std::string_view payload) const {
+    uint64_t digest = 0;
+    for (int i = 0; i < rounds_; ++i) {
+      digest = Round(payload, digest);
+    }
+    return digest;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const WorkKernel &k) {
+    return os << k.name_ << " x" << k.rounds_;
+  }
+};
+
+namespace work {
+
+inline uint64_t Rotl(uint64_t x, int r) noexcept {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Load64(const uint8_t *p) noexcept {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// CRC32C of the payload, the checksum storage and network stacks use
+class Crc32cKernel final : public WorkKernel {
+protected:
+  uint64_t Round(std::string_view payload, uint64_t seed) const override {
+    return crc32c::Extend(static_cast<uint32_t>(seed), payload.data(),
+                          payload.size());
+  }
+
+public:
+  explicit Crc32cKernel(int rounds) : WorkKernel("crc32c", rounds) {}
+};
+
+// XXH64 of the payload, a non-cryptographic hash at memory speed
+class XxHashKernel final : public WorkKernel {
+  static constexpr uint64_t kP1 = 11400714785074694791ULL;
+  static constexpr uint64_t kP2 = 14029467366897019727ULL;
+  static constexpr uint64_t kP3 = 1609587929392839161ULL;
+  static constexpr uint64_t kP4 = 9650029242287828579ULL;
+  static constexpr uint64_t kP5 = 2870177450012600261ULL;
+
+  static uint64_t Mix(uint64_t acc, uint64_t input) noexcept {
+    return Rotl(acc + input * kP2, 31) * kP1;
+  }
+
+  static uint64_t Merge(uint64_t acc, uint64_t v) noexcept {
+    return (acc ^ Mix(0, v)) * kP1 + kP4;
+  }
+
+protected:
+  uint64_t Round(std::string_view payload, uint64_t seed) const override {
+    const auto *p = reinterpret_cast<const uint8_t *>(payload.data());
+    const uint8_t *end = p + payload.size();
+    uint64_t h;
+    if (payload.size() >= 32) {
+      uint64_t v1 = seed + kP1 + kP2, v2 = seed + kP2, v3 = seed,
+               v4 = seed - kP1;
+      for (; end - p >= 32; p += 32) {
+        v1 = Mix(v1, Load64(p));
+        v2 = Mix(v2, Load64(p + 8));
+        v3 = Mix(v3, Load64(p + 16));
+        v4 = Mix(v4, Load64(p + 24));
+      }
+      h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+      h = Merge(Merge(Merge(Merge(h, v1), v2), v3), v4);
+    } else {
+      h = seed + kP5;
+    }
+    h += payload.size();
+    for (; end - p >= 8; p += 8) {
+      h = Rotl(h ^ Mix(0, Load64(p)), 27) * kP1 + kP4;
+    }
+    if (end - p >= 4) {
+      uint32_t word;
+      std::memcpy(&word, p, sizeof(word));
+      h = Rotl(h ^ (word * kP1), 23) * kP2 + kP3;
+      p += 4;
+    }
+    for (; p < end; ++p) {
+      h = Rotl(h ^ (*p * kP5), 11) * kP1;
+    }
+    h ^= h >> 33;
+    h *= kP2;
+    h ^= h >> 29;
+    h *= kP3;
+    return h ^ (h >> 32);
+  }
+
+public:
+  explicit XxHashKernel(int rounds) : WorkKernel("xxhash", rounds) {}
+};
+
+// Byte-wise affine transform of the payload into a scratch copy, 32 lanes at
+// a time through the compiler's vector extensions, which map onto whatever
+// SIMD width -march allows
+class TransformKernel final : public WorkKernel {
+  using Bytes = uint8_t __attribute__((vector_size(32)));
+
+protected:
+  uint64_t Round(std::string_view payload, uint64_t seed) const override {
+    const auto *in = reinterpret_cast<const uint8_t *>(payload.data());
+    uint8_t *out = Scratch(payload.size());
+    const auto key = static_cast<uint8_t>(seed ^ (seed >> 32));
+    Bytes sum{};
+    size_t i = 0;
+    for (; i + sizeof(Bytes) <= payload.size(); i += sizeof(Bytes)) {
+      Bytes v;
+      std::memcpy(&v, in + i, sizeof(v));
+      v = (v * 31 + 7) ^ key;
+      std::memcpy(out + i, &v, sizeof(v));
+      sum += v;
+    }
+    uint64_t digest = seed * 31 + payload.size();
+    for (; i < payload.size(); ++i) {
+      out[i] = static_cast<uint8_t>((in[i] * 31 + 7) ^ key);
+      digest += out[i];
+    }
+    for (size_t lane = 0; lane < sizeof(Bytes); lane += 8) {
+      uint64_t word;
+      std::memcpy(&word, reinterpret_cast<const uint8_t *>(&sum) + lane,
+                  sizeof(word));
+      digest = Rotl(digest, 17) ^ word;
+    }
+    return digest;
+  }
+
+public:
+  explicit TransformKernel(int rounds) : WorkKernel("transform", rounds) {}
+};
+
+// Product of two 16x16 integer matrices, one filled from the payload's first
+// bytes and the seed, the other constant. Unlike the other kernels its cost
+// does not depend on the payload size, so it loads even empty pings.
+class MatMulKernel final : public WorkKernel {
+  static constexpr int kDim = 16;
+
+protected:
+  uint64_t Round(std::string_view payload, uint64_t seed) const override {
+    uint32_t a[kDim][kDim];
+    const size_t n = std::min(payload.size(), sizeof(a) / sizeof(uint32_t));
+    for (int i = 0; i < kDim; ++i) {
+      for (int j = 0; j < kDim; ++j) {
+        const size_t index = i * kDim + j;
+        a[i][j] = static_cast<uint32_t>(seed >> (index % 32)) + index;
+        if (index < n) {
+          a[i][j] += static_cast<uint8_t>(payload[index]);
+        }
+      }
+    }
+    uint32_t c[kDim][kDim] = {};
+    for (int i = 0; i < kDim; ++i) {
+      for (int k = 0; k < kDim; ++k) {
+        // b[k][j] = 2k + j + 1, built inline so the loop vectorizes over j
+        for (int j = 0; j < kDim; ++j) {
+          c[i][j] += a[i][k] * static_cast<uint32_t>(2 * k + j + 1);
+        }
+      }
+    }
+    uint64_t digest = seed;
+    for (int i = 0; i < kDim; ++i) {
+      for (int j = 0; j < kDim; ++j) {
+        digest = Rotl(digest, 5) ^ c[i][j];
+      }
+    }
+    return digest;
+  }
+
+public:
+  explicit MatMulKernel(int rounds) : WorkKernel("matmul", rounds) {}
+};
+
+#if defined(__AES__)
+// AES-128 in counter mode with AES-NI, encrypting the payload into a scratch
+// copy under a fixed key; the counter starts from the seed
+class AesKernel final : public WorkKernel {
+  __m128i keys_[11];
+
+  template <int Rcon> static __m128i Expand(__m128i key) noexcept {
+    __m128i t = _mm_aeskeygenassist_si128(key, Rcon);
+    t = _mm_shuffle_epi32(t, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, t);
+  }
+
+  __m128i Encrypt(__m128i block) const noexcept {
+    block = _mm_xor_si128(block, keys_[0]);
+    for (int r = 1; r < 10; ++r) {
+      block = _mm_aesenc_si128(block, keys_[r]);
+    }
+    return _mm_aesenclast_si128(block, keys_[10]);
+  }
+
+protected:
+  uint64_t Round(std::string_view payload, uint64_t seed) const override {
+    const auto *in = reinterpret_cast<const uint8_t *>(payload.data());
+    uint8_t *out = Scratch(payload.size());
+    __m128i sum = _mm_set_epi64x(0, static_cast<int64_t>(payload.size()));
+    for (size_t i = 0; i < payload.size(); i += 16) {
+      const __m128i counter =
+          _mm_set_epi64x(static_cast<int64_t>(seed), static_cast<int64_t>(i));
+      uint8_t block[16] = {};
+      const size_t n = std::min<size_t>(16, payload.size() - i);
+      std::memcpy(block, in + i, n);
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+      v = _mm_xor_si128(v, Encrypt(counter));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(block), v);
+      std::memcpy(out + i, block, n);
+      sum = _mm_xor_si128(_mm_shuffle_epi32(sum, 0x4e), v);
+    }
+    uint64_t halves[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(halves), sum);
+    return halves[0] ^ Rotl(halves[1], 32);
+  }
+
+public:
+  explicit AesKernel(int rounds) : WorkKernel("aes", rounds) {
+    keys_[0] = _mm_set_epi64x(0x0f0e0d0c0b0a0908, 0x0706050403020100);
+    keys_[1] = Expand<0x01>(keys_[0]);
+    keys_[2] = Expand<0x02>(keys_[1]);
+    keys_[3] = Expand<0x04>(keys_[2]);
+    keys_[4] = Expand<0x08>(keys_[3]);
+    keys_[5] = Expand<0x10>(keys_[4]);
+    keys_[6] = Expand<0x20>(keys_[5]);
+    keys_[7] = Expand<0x40>(keys_[6]);
+    keys_[8] = Expand<0x80>(keys_[7]);
+    keys_[9] = Expand<0x1b>(keys_[8]);
+    keys_[10] = Expand<0x36>(keys_[9]);
+  }
+};
+#endif
+
+template <typename Kernel> std::unique_ptr<WorkKernel> Make(int rounds) {
+  return std::make_unique<Kernel>(rounds);
+}
+
+struct Registration {
+  const char *name;
+  std::unique_ptr<WorkKernel> (*make)(int rounds);
+};
+
+// Built-in kernels; a new one only needs an entry here
+inline constexpr Registration kKernels[] = {
+    {"crc32c", Make<Crc32cKernel>},
+    {"xxhash", Make<XxHashKernel>},
+    {"transform", Make<TransformKernel>},
+    {"matmul", Make<MatMulKernel>},
+#if defined(__AES__)
+    {"aes", Make<AesKernel>},
+#endif
+};
+
+// Names of the built-in kernels, for the --work help text
+inline std::string Names() {
+  std::string names = "none";
+  for (const auto &kernel : kKernels) {
+    names += std::string(", ") + kernel.name;
+  }
+  return names;
+}
+
+// For banners: the kernel and its rounds, or none
+inline std::string Describe(const WorkKernel *kernel) {
+  if (kernel == nullptr) {
+    return "none";
+  }
+  std::ostringstream os;
+  os << *kernel;
+  return os.str();
+}
+
+// Builds the kernel a --work value names; "none" leaves *kernel empty
+inline bool Parse(const std::string &value,
+                  std::unique_ptr<WorkKernel> *kernel) {
+  kernel->reset();
+  if (value == "none") {
+    return true;
+  }
+  const size_t colon = value.find(':');
+  const std::string name = value.substr(0, colon);
+  int rounds = 1;
+  if (colon != std::string::npos) {
+    try {
+      size_t end = 0;
+      rounds = std::stoi(value.substr(colon + 1), &end);
+      if (end != value.size() - colon - 1 || rounds < 1) {
+        return false;
+      }
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+  for (const auto &registration : kKernels) {
+    if (name == registration.name) {
+      *kernel = registration.make(rounds);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace work
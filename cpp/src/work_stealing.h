@@ -0,0 +1,253 @@
+#pragma once
+
+#include <boost/fiber/all.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "idle.h"
+#include "timer_wheel.h"
+
+// Chase-Lev deque of ready fibers. The owning thread pushes and pops at the
+// bottom without locking, peers steal from the top with a single CAS.
+class StealDeque {
+  using context = boost::fibers::context;
+
+  struct Array {
+    const int64_t capacity;
+    std::unique_ptr<std::atomic<context *>[]> slots;
+
+    explicit Array(int64_t cap)
+        : capacity(cap), slots(new std::atomic<context *>[cap]) {}
+
+    context *Get(int64_t i) const noexcept {
+      return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void Put(int64_t i, context *ctx) noexcept {
+      slots[i & (capacity - 1)].store(ctx, std::memory_order_relaxed);
+    }
+  };
+
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  alignas(64) std::atomic<Array *> array_;
+  // Thieves may still read a replaced array, so it lives until destruction
+  std::vector<std::unique_ptr<Array>> arrays_;
+
+  Array *Grow(Array *old, int64_t bottom, int64_t top) {
+    auto grown = std::make_unique<Array>(old->capacity * 2);
+    for (int64_t i = top; i != bottom; ++i) {
+      grown->Put(i, old->Get(i));
+    }
+    Array *a = grown.get();
+    arrays_.push_back(std::move(grown));
+    array_.store(a, std::memory_order_release);
+    return a;
+  }
+
+public:
+  explicit StealDeque(int64_t capacity = 256) {
+    arrays_.push_back(std::make_unique<Array>(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  bool Empty() const noexcept {
+    return bottom_.load(std::memory_order_relaxed) <=
+           top_.load(std::memory_order_relaxed);
+  }
+
+  // Owner only
+  void Push(context *ctx) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array *a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      a = Grow(a, b, t);
+    }
+    a->Put(b, ctx);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only
+  context *Pop() noexcept {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array *a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    context *ctx = a->Get(b);
+    if (t == b) {
+      // Last element, race against thieves for it
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        ctx = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return ctx;
+  }
+
+  // Any thread
+  context *Steal() noexcept {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    context *ctx = array_.load(std::memory_order_acquire)->Get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return ctx;
+  }
+};
+
+// Fiber scheduler with one lock-free deque per worker thread; idle workers
+// steal fibers from their peers. Pinned contexts (main and dispatcher) never
+// migrate and are kept in a private queue.
+class WorkStealingScheduler : public boost::fibers::algo::algorithm {
+public:
+  // Schedulers that steal from each other, one per worker thread. The group
+  // owns the deques and parkers so that peers may keep touching them while a
+  // worker thread tears down its scheduler.
+  class Group {
+    friend class WorkStealingScheduler;
+
+    struct alignas(64) Slot {
+      StealDeque deque;
+      Parker parker;
+      std::atomic<bool> idle{false};
+    };
+
+    const size_t size_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint32_t> idle_{0};
+    const IdlePolicy policy_;
+
+  public:
+    Group(size_t size, const IdlePolicy &policy)
+        : size_(size), slots_(new Slot[size]), policy_(policy) {}
+
+    size_t size() const noexcept { return size_; }
+  };
+
+private:
+  using context = boost::fibers::context;
+
+  Group &group_;
+  Group::Slot &self_;
+  const uint32_t id_;
+  boost::fibers::scheduler::ready_queue_type pinned_{};
+  // Delayed fibers wake up on the thread they were delayed on, from where
+  // peers may steal them again
+  FiberTimers timers_{};
+  uint64_t rng_;
+
+  uint32_t NextVictim() noexcept {
+    // xorshift64
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 7;
+    rng_ ^= rng_ << 17;
+    return static_cast<uint32_t>(rng_ % group_.size());
+  }
+
+  context *StealFromPeers() noexcept {
+    const uint32_t n = group_.size();
+    const uint32_t start = NextVictim();
+    for (uint32_t i = 0; i < n; ++i) {
+      const uint32_t victim = (start + i) % n;
+      if (victim == id_) {
+        continue;
+      }
+      if (context *ctx = group_.slots_[victim].deque.Steal()) {
+        return ctx;
+      }
+    }
+    return nullptr;
+  }
+
+  bool PeersHaveWork() const noexcept {
+    for (uint32_t i = 0; i < group_.size(); ++i) {
+      if (i != id_ && !group_.slots_[i].deque.Empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void WakeIdlePeer() noexcept {
+    for (uint32_t i = 0; i < group_.size(); ++i) {
+      auto &peer = group_.slots_[i];
+      if (i != id_ && peer.idle.load(std::memory_order_relaxed)) {
+        peer.parker.Notify();
+        return;
+      }
+    }
+  }
+
+public:
+  WorkStealingScheduler(Group &group, uint32_t id)
+      : group_(group), self_(group.slots_[id]), id_(id),
+        rng_(0x9e3779b97f4a7c15ULL * (id + 1)) {}
+
+  void awakened(context *ctx) noexcept override {
+    if (ctx->is_context(boost::fibers::type::pinned_context)) {
+      pinned_.push_back(*ctx);
+      return;
+    }
+    ctx->detach();
+    self_.deque.Push(ctx);
+    // Pairs with the fence in suspend_until so a peer going idle either sees
+    // this fiber or gets notified to steal it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (group_.idle_.load(std::memory_order_relaxed) != 0) {
+      WakeIdlePeer();
+    }
+  }
+
+  context *pick_next() noexcept override {
+    timers_.Expire();
+    context *ctx = nullptr;
+    if (!pinned_.empty()) {
+      ctx = &pinned_.front();
+      pinned_.pop_front();
+      return ctx;
+    }
+    ctx = self_.deque.Pop();
+    if (ctx == nullptr) {
+      ctx = StealFromPeers();
+    }
+    if (ctx != nullptr) {
+      context::active()->attach(ctx);
+    }
+    return ctx;
+  }
+
+  bool has_ready_fibers() const noexcept override {
+    return !pinned_.empty() || !self_.deque.Empty();
+  }
+
+  void suspend_until(std::chrono::steady_clock::time_point const
+                         &time_point) noexcept override {
+    self_.idle.store(true, std::memory_order_relaxed);
+    group_.idle_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!PeersHaveWork()) {
+      self_.parker.Wait(timers_.Deadline(time_point), group_.policy_);
+    }
+    group_.idle_.fetch_sub(1, std::memory_order_relaxed);
+    self_.idle.store(false, std::memory_order_relaxed);
+  }
+
+  void notify() noexcept override { self_.parker.Notify(); }
+};
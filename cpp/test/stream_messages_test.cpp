@@ -0,0 +1,109 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "alloc_counter.h"
+#include "pingpong.pb.h"
+#include "stream_messages.h"
+
+using namespace pingpong;
+
+// Runs pings through StreamMessages the way the shm and io_uring engines do,
+// parsing wire bytes, echoing and serializing the pong, and checks that once
+// the buffers have grown to size a message makes no allocations at all.
+
+static constexpr int kWarmup = 16;
+static constexpr int kMessages = 10000;
+static constexpr size_t kPayload = 1024;
+
+static int failures = 0;
+
+static void Check(bool ok, const std::string &what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << "\n";
+    ++failures;
+  }
+}
+
+// One message through the stream; false if the ping does not parse
+static bool RoundTrip(StreamMessages &msgs, const std::string &request,
+                      std::string *reply) {
+  if (!msgs.Parse(request.data(), request.size())) {
+    return false;
+  }
+  msgs.Echo(42, nullptr);
+  msgs.Serialize(reply);
+  msgs.Recycle();
+  return true;
+}
+
+static void SteadyState(bool checksum, int reset_every) {
+  const std::string name = std::string(checksum ? "checksum" : "plain") +
+                           " reset_every=" + std::to_string(reset_every);
+  Ping ping;
+  ping.set_sequence(7);
+  ping.set_timestamp(1234);
+  ping.set_payload(std::string(kPayload, 'x'));
+  if (checksum) {
+    ping.set_checksum(crc32c::Value(ping.payload().data(), kPayload));
+  }
+  const std::string request = ping.SerializeAsString();
+  std::string reply;
+  reply.reserve(2 * kPayload);
+
+  const uint64_t messages_before =
+      HandlerStats::Global().messages.load(std::memory_order_relaxed);
+  const uint64_t allocations_before =
+      HandlerStats::Global().allocations.load(std::memory_order_relaxed);
+  uint64_t steady = 0;
+  {
+    StreamMessages msgs(reset_every);
+    for (int i = 0; i < kWarmup; ++i) {
+      Check(RoundTrip(msgs, request, &reply), name + " warmup parse");
+    }
+    const uint64_t start = ThreadAllocations();
+    for (int i = 0; i < kMessages; ++i) {
+      if (!RoundTrip(msgs, request, &reply)) {
+        Check(false, name + " parse");
+        break;
+      }
+    }
+    steady = ThreadAllocations() - start;
+  }
+  const uint64_t messages =
+      HandlerStats::Global().messages.load(std::memory_order_relaxed) -
+      messages_before;
+  const uint64_t allocations =
+      HandlerStats::Global().allocations.load(std::memory_order_relaxed) -
+      allocations_before;
+
+  Pong pong;
+  Check(pong.ParseFromString(reply), name + " reply parses");
+  Check(pong.sequence() == 7 && pong.timestamp() == 1234 &&
+            pong.server_timestamp() == 42 && pong.payload() == ping.payload(),
+        name + " reply echoes the ping");
+  Check(pong.has_checksum() == checksum, name + " reply checksum");
+  Check(messages == kWarmup + kMessages, name + " handler messages");
+  if (reset_every == 0) {
+    Check(steady == 0, name + " steady-state allocations " +
+                           std::to_string(steady) + " != 0");
+  }
+  // Whatever the stream allocated was counted as the handler's
+  Check(allocations >= steady, name + " handler allocations counted");
+  std::cout << name << ": " << messages << " messages, " << steady
+            << " steady-state allocations, handler allocations="
+            << allocations << "\n";
+}
+
+int main() {
+  SteadyState(false, 0);
+  SteadyState(true, 0);
+  // Arena resets allocate by design; the counter must still see them
+  SteadyState(false, 1000);
+  if (failures != 0) {
+    std::cerr << failures << " check(s) failed\n";
+    return 1;
+  }
+  std::cout << "OK\n";
+  return 0;
+}
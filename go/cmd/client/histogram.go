@@ -0,0 +1,99 @@
+package main
+
+import (
+	"fmt"
+	"math/bits"
+	"sync/atomic"
+)
+
+// Log-linear latency histogram in the style of HdrHistogram, laid out like
+// cpp/src/histogram.h: values are bucketed by power of two and each power is
+// split into 64 linear sub-buckets, keeping the relative error below 1.6%.
+const (
+	subBucketBits = 7
+	subBucketHalf = 1 << (subBucketBits - 1)
+	numBuckets    = (64 - subBucketBits + 2) * subBucketHalf
+)
+
+func bucketIndex(v uint64) int {
+	msb := 63 - bits.LeadingZeros64(v|1)
+	shift := max(0, msb-subBucketBits+1)
+	return shift*subBucketHalf + int(v>>shift)
+}
+
+// bucketValue is the highest value that lands in bucket i
+func bucketValue(i int) uint64 {
+	shift := max(0, i/subBucketHalf-1)
+	sub := uint64(i - shift*subBucketHalf)
+	return ((sub + 1) << shift) - 1
+}
+
+// histogram is written by one goroutine and read by the reporter
+type histogram struct {
+	counts [numBuckets]atomic.Uint64
+	total  atomic.Uint64
+	max    atomic.Uint64
+}
+
+func (h *histogram) record(v uint64) {
+	h.counts[bucketIndex(v)].Add(1)
+	h.total.Add(1)
+	if v > h.max.Load() {
+		h.max.Store(v)
+	}
+}
+
+// histSnapshot is a plain copy of one or more merged histograms
+type histSnapshot struct {
+	counts [numBuckets]uint64
+	total  uint64
+	max    uint64
+}
+
+func (s *histSnapshot) add(h *histogram) {
+	for i := range h.counts {
+		s.counts[i] += h.counts[i].Load()
+	}
+	s.total += h.total.Load()
+	s.max = max(s.max, h.max.Load())
+}
+
+// since returns what was recorded after prev; its max is the upper bound of
+// the highest non-empty bucket
+func (s *histSnapshot) since(prev *histSnapshot) *histSnapshot {
+	d := &histSnapshot{}
+	for i := range s.counts {
+		n := s.counts[i] - prev.counts[i]
+		d.counts[i] = n
+		d.total += n
+		if n != 0 {
+			d.max = bucketValue(i)
+		}
+	}
+	d.max = min(d.max, s.max)
+	return d
+}
+
+func (s *histSnapshot) percentile(p float64) uint64 {
+	if s.total == 0 {
+		return 0
+	}
+	rank := uint64(p/100*float64(s.total) + 0.5)
+	rank = min(max(rank, 1), s.total)
+	var seen uint64
+	for i, n := range s.counts {
+		seen += n
+		if seen >= rank {
+			return min(bucketValue(i), s.max)
+		}
+	}
+	return s.max
+}
+
+// String summarizes the snapshot, values in microseconds
+func (s *histSnapshot) String() string {
+	us := func(ns uint64) float64 { return float64(ns) / 1000 }
+	return fmt.Sprintf("count=%d p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus",
+		s.total, us(s.percentile(50)), us(s.percentile(90)), us(s.percentile(99)),
+		us(s.percentile(99.9)), us(s.max))
+}
@@ -3,17 +3,146 @@ package main
 import (
 	"context"
 	"flag"
+	"fmt"
+	"hash/crc32"
 	"log"
+	"os"
+	"os/signal"
+	"strings"
+	"sync/atomic"
+	"syscall"
 	"time"
 
 	"google.golang.org/grpc"
 	"google.golang.org/grpc/credentials/insecure"
+	"google.golang.org/grpc/metadata"
 	pb "pingpong/pkg/proto/pingpong"
 )
 
-func runWorker(id int, conn *grpc.ClientConn, payloadLen int) {
+// latencyStats are the histograms of one worker, in nanoseconds, and its
+// payload integrity counts
+type latencyStats struct {
+	rtt      histogram // ping sent to pong received
+	request  histogram // ping sent to server timestamp
+	response histogram // server timestamp to pong received
+
+	checked    atomic.Uint64 // pongs whose checksum was verified
+	mismatches atomic.Uint64 // of which failed
+}
+
+// record takes the pong's echoed send time and server timestamp; both ends
+// stamp wall clock nanoseconds, so the one-way legs assume synced clocks
+func (l *latencyStats) record(pong *pb.Pong, now uint64) {
+	l.rtt.record(delta(pong.Timestamp, now))
+	l.request.record(delta(pong.Timestamp, pong.ServerTimestamp))
+	l.response.record(delta(pong.ServerTimestamp, now))
+}
+
+var castagnoli = crc32.MakeTable(crc32.Castagnoli)
+
+// verify checks an echoed payload against the checksum sent with it and the
+// one the server stamped; a missing stamp counts as a mismatch too
+func (l *latencyStats) verify(pong *pb.Pong, sent uint32) {
+	got := crc32.Checksum(pong.Payload, castagnoli)
+	l.checked.Add(1)
+	if pong.Checksum == nil || *pong.Checksum != got || got != sent {
+		l.mismatches.Add(1)
+	}
+}
+
+func delta(from, to uint64) uint64 {
+	if to < from {
+		return 0
+	}
+	return to - from
+}
+
+type latencySnapshot struct {
+	rtt, request, response histSnapshot
+	checked, mismatches    uint64
+}
+
+func snapshot(stats []*latencyStats) *latencySnapshot {
+	s := &latencySnapshot{}
+	for _, l := range stats {
+		s.rtt.add(&l.rtt)
+		s.request.add(&l.request)
+		s.response.add(&l.response)
+		s.checked += l.checked.Load()
+		s.mismatches += l.mismatches.Load()
+	}
+	return s
+}
+
+func (s *latencySnapshot) since(prev *latencySnapshot) *latencySnapshot {
+	return &latencySnapshot{
+		rtt:        *s.rtt.since(&prev.rtt),
+		request:    *s.request.since(&prev.request),
+		response:   *s.response.since(&prev.response),
+		checked:    s.checked - prev.checked,
+		mismatches: s.mismatches - prev.mismatches,
+	}
+}
+
+func (s *latencySnapshot) log(label string) {
+	log.Printf("%s rtt: %v", label, &s.rtt)
+	log.Printf("%s request: %v", label, &s.request)
+	log.Printf("%s response: %v", label, &s.response)
+	if s.checked > 0 {
+		log.Printf("%s integrity: checked=%d mismatches=%d", label, s.checked, s.mismatches)
+	}
+}
+
+// throughput logs a worker's TPS and MB/s every 100000 messages
+type throughput struct {
+	id    int
+	count uint64
+	bytes uint64
+	start time.Time
+}
+
+func (t *throughput) add(payloadLen int) {
+	t.count++
+	t.bytes += 128 + uint64(payloadLen)
+	if t.count%100000 == 0 {
+		elapsed := time.Since(t.start).Seconds()
+		tps := float64(t.count) / elapsed
+		mbps := float64(t.bytes) / elapsed / 1024 / 1024
+		log.Printf("Worker %d: %.2f TPS, %.2f MB/s", t.id, tps, mbps)
+
+		t.start = time.Now()
+		t.count = 0
+		t.bytes = 0
+	}
+}
+
+// connMetadataKey names the client connection a stream belongs to, so the
+// server can count streams per connection even where peer addresses of unix
+// sockets are all alike
+const connMetadataKey = "pingpong-conn"
+
+// messageOverhead bounds the bytes a Ping or Pong spends besides its payload
+// bytes: four 64-bit varints, the payload's tag and length, more and the
+// checksum come to at most 57
+const messageOverhead = 64
+
+// splitPayload cuts payload into chunks of at most chunkSize bytes; with a
+// chunkSize of 0, or a payload that fits, it stays one chunk, even if empty
+func splitPayload(payload []byte, chunkSize int) [][]byte {
+	if chunkSize == 0 || len(payload) <= chunkSize {
+		return [][]byte{payload}
+	}
+	var chunks [][]byte
+	for offset := 0; offset < len(payload); offset += chunkSize {
+		chunks = append(chunks, payload[offset:min(offset+chunkSize, len(payload))])
+	}
+	return chunks
+}
+
+func runWorker(id int, conn *grpc.ClientConn, connID string, payloadLen int, window int, chunkSize int, checksum bool, stats *latencyStats) {
 	client := pb.NewPingPongClient(conn)
-	stream, err := client.StreamPingPong(context.Background())
+	ctx := metadata.AppendToOutgoingContext(context.Background(), connMetadataKey, connID)
+	stream, err := client.StreamPingPong(ctx)
 	if err != nil {
 		log.Printf("Worker %d stream error: %v", id, err)
 		return
@@ -23,14 +152,33 @@ func runWorker(id int, conn *grpc.ClientConn, payloadLen int) {
 		payload[i] = byte(i + id%256)
 	}
 
-	var count uint64 = 0
-	var bytes uint64 = 0
-	start := time.Now()
+	// The payload never changes, so its chunks' checksums are computed once;
+	// nil leaves them off
+	chunks := splitPayload(payload, chunkSize)
+	var sums []uint32
+	if checksum {
+		for _, chunk := range chunks {
+			sums = append(sums, crc32.Checksum(chunk, castagnoli))
+		}
+	}
+
+	tp := &throughput{id: id, start: time.Now()}
+	if chunkSize > 0 {
+		runChunked(id, stream, chunks, sums, stats, tp)
+		return
+	}
+	if window > 1 {
+		runPipelined(id, stream, payload, sums, window, stats, tp)
+		return
+	}
 
 	var ping pb.Ping
-	for {
+	if sums != nil {
+		ping.Checksum = &sums[0]
+	}
+	for seq := uint64(0); ; seq++ {
 		// Send
-		ping.Sequence = count
+		ping.Sequence = seq
 		ping.Timestamp = uint64(time.Now().UnixNano())
 		ping.Payload = payload
 		if err := stream.Send(&ping); err != nil {
@@ -45,19 +193,128 @@ func runWorker(id int, conn *grpc.ClientConn, payloadLen int) {
 			return
 		}
 
-		count++
-		bytes += 128 + uint64(len(pong.Payload))
+		stats.record(pong, uint64(time.Now().UnixNano()))
+		if sums != nil {
+			stats.verify(pong, sums[0])
+		}
+		tp.add(len(pong.Payload))
+	}
+}
+
+// runPipelined keeps up to window pings in flight: the sender takes a credit
+// per ping and the receiver hands it back per pong, checking that pongs come
+// back in sequence order
+func runPipelined(id int, stream pb.PingPong_StreamPingPongClient, payload []byte,
+	sums []uint32, window int, stats *latencyStats, tp *throughput,
+) {
+	credits := make(chan struct{}, window)
+	for i := 0; i < window; i++ {
+		credits <- struct{}{}
+	}
+	done := make(chan struct{})
+
+	go func() {
+		defer close(done)
+		for seq := uint64(0); ; seq++ {
+			pong, err := stream.Recv()
+			if err != nil {
+				log.Printf("Worker %d receive error: %v", id, err)
+				return
+			}
+			if pong.Sequence != seq {
+				log.Printf("Worker %d: pong sequence %d, expected %d", id, pong.Sequence, seq)
+				return
+			}
+			stats.record(pong, uint64(time.Now().UnixNano()))
+			if sums != nil {
+				stats.verify(pong, sums[0])
+			}
+			tp.add(len(pong.Payload))
+			credits <- struct{}{}
+		}
+	}()
+
+	var ping pb.Ping
+	if sums != nil {
+		ping.Checksum = &sums[0]
+	}
+	for seq := uint64(0); ; seq++ {
+		select {
+		case <-credits:
+		case <-done:
+			return
+		}
+		ping.Sequence = seq
+		ping.Timestamp = uint64(time.Now().UnixNano())
+		ping.Payload = payload
+		if err := stream.Send(&ping); err != nil {
+			log.Printf("Worker %d send error: %v", id, err)
+			return
+		}
+	}
+}
 
-		// Report every second
-		if count%100000 == 0 {
-			elapsed := time.Since(start).Seconds()
-			tps := float64(count) / elapsed
-			mbps := float64(bytes) / elapsed / 1024 / 1024
-			log.Printf("Worker %d: %.2f TPS, %.2f MB/s", id, tps, mbps)
+// runChunked sends each payload as a run of pings, one per chunk, and starts
+// the next transfer once the last pong chunk is back. The server
+// echoes chunk by chunk, so receiving runs alongside sending; otherwise a
+// payload beyond the flow control windows would stall both ends. Latency is
+// recorded per transfer, throughput per chunk.
+func runChunked(id int, stream pb.PingPong_StreamPingPongClient, chunks [][]byte,
+	sums []uint32, stats *latencyStats, tp *throughput,
+) {
+	next := make(chan struct{}, 1)
+	next <- struct{}{}
+	done := make(chan struct{})
+
+	go func() {
+		defer close(done)
+		for seq := uint64(0); ; seq++ {
+			for chunk := 0; ; chunk++ {
+				pong, err := stream.Recv()
+				if err != nil {
+					log.Printf("Worker %d receive error: %v", id, err)
+					return
+				}
+				if pong.Sequence != seq {
+					log.Printf("Worker %d: pong sequence %d, expected %d", id, pong.Sequence, seq)
+					return
+				}
+				if chunk < len(sums) {
+					stats.verify(pong, sums[chunk])
+				} else if sums != nil {
+					// More chunks came back than were sent
+					stats.checked.Add(1)
+					stats.mismatches.Add(1)
+				}
+				tp.add(len(pong.Payload))
+				if !pong.More {
+					stats.record(pong, uint64(time.Now().UnixNano()))
+					break
+				}
+			}
+			next <- struct{}{}
+		}
+	}()
 
-			start = time.Now()
-			count = 0
-			bytes = 0
+	var ping pb.Ping
+	for seq := uint64(0); ; seq++ {
+		select {
+		case <-next:
+		case <-done:
+			return
+		}
+		ping.Sequence = seq
+		ping.Timestamp = uint64(time.Now().UnixNano())
+		for i, chunk := range chunks {
+			ping.Payload = chunk
+			ping.More = i+1 < len(chunks)
+			if sums != nil {
+				ping.Checksum = &sums[i]
+			}
+			if err := stream.Send(&ping); err != nil {
+				log.Printf("Worker %d send error: %v", id, err)
+				return
+			}
 		}
 	}
 }
@@ -65,28 +322,98 @@ func runWorker(id int, conn *grpc.ClientConn, payloadLen int) {
 func main() {
 	payloadSize := flag.Int("payload", 0, "Payload size in bytes")
 	workers := flag.Int("workers", 1, "Number of workers")
+	window := flag.Int("window", 1, "Pings in flight per stream, 1 is lockstep")
+	chunkSize := flag.Int("chunk-size", 0, "Split each payload into pings of at most this many bytes, 0 sends it whole if it fits in -max-message-size")
+	checksum := flag.Bool("checksum", false, "Send a CRC32C with every payload and verify the echoed payloads against it")
+	maxMessageSize := flag.Int("max-message-size", 16*1024, "Largest gRPC message sent or accepted, matching the server's --max-message-size")
+	interval := flag.Duration("interval", 5*time.Second, "Latency report interval")
+	duration := flag.Duration("duration", 0, "Run time, 0 runs until interrupted")
+	target := flag.String("target", "unix:///tmp/pingpong.sock", "Server address: unix:///path, unix-abstract:name or host:port")
+	shards := flag.Int("shards", 1, "Server shards to spread workers across, matching the server's --shards")
+	numConns := flag.Int("conns", 0, "Connections to open, spread over the shards; workers take them round-robin. 0 opens one per shard")
 	flag.Parse()
 
-	const max_size = 16 * 1024
-	conn, err := grpc.Dial(
-		"unix:///tmp/pingpong.sock",
-		grpc.WithTransportCredentials(insecure.NewCredentials()),
-		grpc.WithInitialWindowSize(max_size),
-		grpc.WithInitialConnWindowSize(max_size),
-		grpc.WithDefaultCallOptions(
-			grpc.MaxCallRecvMsgSize(max_size),
-			grpc.MaxCallSendMsgSize(max_size),
-		),
-	)
-	if err != nil {
-		log.Fatalf("Failed to connect: %v", err)
+	if *shards < 1 {
+		log.Fatalf("-shards must be at least 1")
+	}
+	if *numConns == 0 {
+		*numConns = *shards
+	}
+	if *numConns < *shards {
+		log.Fatalf("-conns must be at least -shards")
+	}
+	if *chunkSize < 0 || *maxMessageSize <= messageOverhead {
+		log.Fatalf("-chunk-size must be positive and -max-message-size above %v", messageOverhead)
+	}
+	// A chunk travels in one message, and so does its echo
+	maxChunk := *maxMessageSize - messageOverhead
+	if *chunkSize > maxChunk {
+		log.Fatalf("-chunk-size must leave %v bytes of -max-message-size for the other fields, at most %v", messageOverhead, maxChunk)
+	}
+	if *chunkSize == 0 && *payloadSize > maxChunk {
+		*chunkSize = maxChunk
+	}
+	if *chunkSize > 0 && *window > 1 {
+		log.Fatalf("chunked payloads run in lockstep, -window must be 1")
+	}
+	conns := make([]*grpc.ClientConn, *numConns)
+	connIDs := make([]string, *numConns)
+	for i := range conns {
+		// A sharded server listens on one unix socket per shard, while TCP
+		// shards share the port and the kernel spreads the connections
+		target := *target
+		if *shards > 1 && strings.HasPrefix(target, "unix") {
+			target = fmt.Sprintf("%s.%d", target, i%*shards)
+		}
+		conn, err := grpc.Dial(
+			target,
+			grpc.WithTransportCredentials(insecure.NewCredentials()),
+			grpc.WithInitialWindowSize(int32(*maxMessageSize)),
+			grpc.WithInitialConnWindowSize(int32(*maxMessageSize)),
+			grpc.WithDefaultCallOptions(
+				grpc.MaxCallRecvMsgSize(*maxMessageSize),
+				grpc.MaxCallSendMsgSize(*maxMessageSize),
+			),
+		)
+		if err != nil {
+			log.Fatalf("Failed to connect to %v: %v", target, err)
+		}
+		defer conn.Close()
+		conns[i] = conn
+		connIDs[i] = fmt.Sprintf("%d.%d", os.Getpid(), i)
 	}
-	defer conn.Close()
 
-	log.Printf("Starting %v clients, payloadSize: %v", *workers, *payloadSize)
+	log.Printf("Starting %v clients on %v over %v connections across %v shards, payloadSize: %v, window: %v, chunkSize: %v, checksum: %v",
+		*workers, *target, *numConns, *shards, *payloadSize, *window, *chunkSize, *checksum)
+	stats := make([]*latencyStats, *workers)
 	for i := 0; i < *workers; i++ {
-		go runWorker(i, conn, *payloadSize)
+		stats[i] = &latencyStats{}
+		c := i % len(conns)
+		go runWorker(i, conns[c], connIDs[c], *payloadSize, *window, *chunkSize, *checksum, stats[i])
+	}
+
+	stop := make(chan os.Signal, 1)
+	signal.Notify(stop, os.Interrupt, syscall.SIGTERM)
+	var deadline <-chan time.Time
+	if *duration > 0 {
+		deadline = time.After(*duration)
 	}
+	ticker := time.NewTicker(*interval)
+	defer ticker.Stop()
 
-	select {}
+	prev := &latencySnapshot{}
+	for {
+		select {
+		case <-ticker.C:
+			now := snapshot(stats)
+			now.since(prev).log("interval")
+			prev = now
+		case <-stop:
+			snapshot(stats).log("total")
+			return
+		case <-deadline:
+			snapshot(stats).log("total")
+			return
+		}
+	}
 }